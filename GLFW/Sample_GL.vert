@@ -4,7 +4,13 @@
 layout (location = 0) in vec3 vertexPosition;
 layout (location = 1) in vec3 vertexColor;
 
+// per-instance data of the tile pass : xyz = tile offset, w = color variant
+layout (location = 2) in vec4 instanceData;
+layout (location = 3) in vec3 vertexColorAlt;
+
 uniform mat4 MVP;
+uniform int instanced;      // 1 while drawing the instanced tile pass (MVP then holds VP)
+uniform vec3 instanceScale; // model scale shared by every tile instance
 
 // output data : used by fragment shader
 out vec3 fragColor;
@@ -17,6 +23,11 @@ void main ()
     // to produce the color of each fragment
     fragColor = vertexColor;
 
+    if (instanced == 1) {
+        v = vec4(vertexPosition * instanceScale + instanceData.xyz, 1);
+        fragColor = mix(vertexColor, vertexColorAlt, instanceData.w);
+    }
+
     // Output position of the vertex, in clip space : MVP * position
     gl_Position = MVP * v;
 }
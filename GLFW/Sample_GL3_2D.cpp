@@ -2,6 +2,13 @@
 #include <cmath>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cctype>
+#include <chrono>
+#include <atomic>
+#include <mutex>
 #include<unistd.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -10,217 +17,180 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <FTGL/ftgl.h>
 
-using namespace std;
-
-struct VAO {
-	GLuint VertexArrayID;
-	GLuint VertexBuffer;
-	GLuint ColorBuffer;
+#include "level.h"
+#include "board.h"
+#include "sim.h"
+#include "audio.h"
+#include "trace.h"
+#include "profile.h"
+#include "text.h"
+#include "timestep.h"
+#include "capture.h"
+#include "replay.h"
+#include "glstate.h"
+#include "renderq.h"
+#include "cull.h"
+#include "engine.h"
+#include "watch.h"
+#include "ui.h"
 
-	GLenum PrimitiveMode;
-	GLenum FillMode;
-	int NumVertices;
-};
-typedef struct VAO VAO;
-
-struct GLMatrices {
-	glm::mat4 projection;
-	glm::mat4 model;
-	glm::mat4 view;
-	GLuint MatrixID;
-} Matrices;
-
-struct FTGLFont {
-  FTFont* font;
-  GLuint fontMatrixID;
-  GLuint fontColorID;
-} GL3Font;
-
-GLuint programID, fontProgramID, textureProgramID;
-
-/* Function to load Shaders - Use it as it is */
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
-
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open())
-	{
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
-	}
-
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
-	}
-
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
-
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
-
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> VertexShaderErrorMessage(InfoLogLength);
-	glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-	fprintf(stdout, "%s\n", &VertexShaderErrorMessage[0]);
-
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
-
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> FragmentShaderErrorMessage(InfoLogLength);
-	glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-	fprintf(stdout, "%s\n", &FragmentShaderErrorMessage[0]);
-
-	// Link the program
-	fprintf(stdout, "Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
-
-	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> ProgramErrorMessage( max(InfoLogLength, int(1)) );
-	glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-	fprintf(stdout, "%s\n", &ProgramErrorMessage[0]);
-
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
-
-	return ProgramID;
-}
+using namespace std;
 
-static void error_callback(int error, const char* description)
+/* Queue a string for this frame's text batch, MVP maps font units (1 = one em) to clip space.
+   Everything queued is drawn at the end of draw() by text_flush(). */
+void drawText (const char* text, glm::mat4 MVP, glm::vec3 color)
 {
-	fprintf(stderr, "Error: %s\n", description);
+	profile_begin(PROF_TEXT);
+	text_add(text, &MVP[0][0], &color[0]);
+	profile_end(PROF_TEXT);
 }
 
+GLuint fontProgramID, textureProgramID;
+
+unsigned game_ticks=0; // update() calls so far, the input log is timed by it
+int replaying=0;       // --replay feeds the callbacks, the cursor comes from the log
+double replay_x, replay_y;
+
 void quit(GLFWwindow *window)
 {
+	replay_record_stop(game_ticks);
+	watch_stop();
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	//    exit(EXIT_SUCCESS);
 }
 
 
-/* Generate VAO, VBOs and return VAO handle */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
+/* Per-instance data of the tile pass - read by Sample_GL.vert at location 2 */
+struct TileInstance {
+	GLfloat offset[3]; // tile translation in world space
+	GLfloat variant;   // 0 - vertexColor, 1 - vertexColorAlt (checkerboard)
+};
+
+/* Tile kinds - each kind is drawn with a single glDrawArraysInstanced */
+enum TileKind { TILE_NORMAL, TILE_FRAGILE, TILE_KINDS };
+
+/* Mesh vertex of the tile pass, both color variants packed next to the position */
+struct TileVertex {
+	GLfloat pos[3];
+	GLubyte color[4];
+	GLubyte color_alt[4];
+};
+
+struct TileBatch {
+	GLuint VertexArrayID;
+	GLuint MeshBuffer;     // TileVertex per mesh vertex
+	GLuint InstanceBuffer;
+
+	int NumVertices;
+	int Capacity;
+	int Dirty; // Instances changed since the last upload
+	std::vector<TileInstance> Instances;
+	std::vector<TileVertex> Mesh; // kept to bake the settled board from
+};
+
+struct TileRenderer {
+	TileBatch batch[TILE_KINDS];
+	GLuint InstancedID;
+	GLuint ScaleID;
+} Tiles;
+
+/* Generate the VAO of a tile kind: its mesh with two color variants and an instance VBO */
+void createTileBatch (TileBatch* b, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, const GLfloat* color_alt_buffer_data, int capacity)
 {
-	struct VAO* vao = new struct VAO;
-	vao->PrimitiveMode = primitive_mode;
-	vao->NumVertices = numVertices;
-	vao->FillMode = fill_mode;
-
-	// Create Vertex Array Object
-	// Should be done after CreateWindow and before any other GL calls
-	glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
-	glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
-	glGenBuffers (1, &(vao->ColorBuffer));  // VBO - colors
-
-	glBindVertexArray (vao->VertexArrayID); // Bind the VAO 
-	glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices 
-	glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW); // Copy the vertices into VBO
-	glVertexAttribPointer(
-			0,                  // attribute 0. Vertices
-			3,                  // size (x,y,z)
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-			);
-
-	glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors 
-	glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
-	glVertexAttribPointer(
-			1,                  // attribute 1. Color
-			3,                  // size (r,g,b)
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-			);
-
-	return vao;
+	b->NumVertices = numVertices;
+	b->Capacity = capacity;
+	b->Instances.reserve(capacity);
+
+	std::vector<TileVertex>& mesh = b->Mesh;
+	mesh.resize(numVertices);
+	for (int i=0; i<numVertices; i++) {
+		memcpy(mesh[i].pos, vertex_buffer_data + 3*i, sizeof(mesh[i].pos));
+		packColor(mesh[i].color, color_buffer_data + 3*i);
+		packColor(mesh[i].color_alt, color_alt_buffer_data + 3*i);
+	}
+
+	b->VertexArrayID = genVertexArray();
+	b->MeshBuffer = genBuffer();
+	b->InstanceBuffer = genBuffer();
+
+	glstate_bind_vertex_array(b->VertexArrayID);
+
+	glstate_bind_array_buffer(b->MeshBuffer);
+	glBufferData (GL_ARRAY_BUFFER, numVertices*sizeof(TileVertex), &mesh[0], GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TileVertex), (void*)offsetof(TileVertex, pos));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TileVertex), (void*)offsetof(TileVertex, color));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TileVertex), (void*)offsetof(TileVertex, color_alt));
+	glEnableVertexAttribArray(3);
+
+	glstate_bind_array_buffer(b->InstanceBuffer);
+	glBufferData (GL_ARRAY_BUFFER, capacity*sizeof(TileInstance), NULL, GL_STREAM_DRAW);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), (void*)0);
+	glVertexAttribDivisor(2, 1); // advance once per instance
+	glEnableVertexAttribArray(2);
+	glstate_bind_vertex_array(0);
 }
 
-/* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
+void beginTileBatches ()
 {
-	GLfloat* color_buffer_data = new GLfloat [3*numVertices];
-	for (int i=0; i<numVertices; i++) {
-		color_buffer_data [3*i] = red;
-		color_buffer_data [3*i + 1] = green;
-		color_buffer_data [3*i + 2] = blue;
+	for (int k=0; k<TILE_KINDS; k++) {
+		Tiles.batch[k].Instances.clear();
+		Tiles.batch[k].Dirty = 1;
 	}
+}
 
-	return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
+void addTileInstance (int kind, float x, float y, float z, int variant)
+{
+	TileInstance t = { { x, y, z }, (GLfloat)variant };
+	Tiles.batch[kind].Instances.push_back(t);
 }
 
-/* Render the VBOs handled by VAO */
-void draw3DObject (struct VAO* vao)
+/* Upload the instances if they were rebuilt and issue one draw call per tile kind */
+void drawTileBatches (glm::mat4 VP)
 {
-	// Change the Fill Mode for this object
-	glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
+	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &VP[0][0]);
+	glUniform1i(Tiles.InstancedID, 1);
+	glUniform3f(Tiles.ScaleID, 1.5f, 0.4f, 1.5f);
+	glstate_polygon_mode(GL_FILL);
 
-	// Bind the VAO to use
-	glBindVertexArray (vao->VertexArrayID);
+	for (int k=0; k<TILE_KINDS; k++) {
+		TileBatch* b = &Tiles.batch[k];
+		int count = b->Instances.size();
+		if (count == 0)
+			continue;
 
-	// Enable Vertex Attribute 0 - 3d Vertices
-	glEnableVertexAttribArray(0);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
+		glstate_bind_vertex_array(b->VertexArrayID);
+		if (b->Dirty) {
+			glstate_bind_array_buffer(b->InstanceBuffer);
+			if (count > b->Capacity)
+				b->Capacity = count;
+			// Orphan the old storage so we never wait on the previous frame's draw
+			glBufferData (GL_ARRAY_BUFFER, b->Capacity*sizeof(TileInstance), NULL, GL_STREAM_DRAW);
+			glBufferSubData (GL_ARRAY_BUFFER, 0, count*sizeof(TileInstance), &b->Instances[0]);
+			b->Dirty = 0;
+		}
 
-	// Enable Vertex Attribute 1 - Color
-	glEnableVertexAttribArray(1);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, b->NumVertices, count);
+	}
 
-	// Draw the geometry !
-	glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
+	glUniform1i(Tiles.InstancedID, 0);
 }
 
 /**************************
  * Customizable functions *
  **************************/
-int l6=0,r6=0,l7=0,r7=0,r8=0,r9=0;
 
 float triangle_rot_dir = 1;
 float rectangle_rot_dir = 1;
 bool triangle_rot_status = true;
 bool rectangle_rot_status = true;
-int posx1=0,posy1=0,posx2=0,posy2=6,flag=1,posz1=0,posz2=0;
+int flag=1;
 int triangle_rotation;
-int disable=0;
-int l8f=0;
 int moves=0;
-int stmove=0;
+int attempts=1;
 int ent=0;
 int enter=0;
 char ab[2];
@@ -230,13 +200,170 @@ int pass=0;
 int view=0;
 int menu=0;
 int soff=0;
-int l3=0,r3=0;
-int r4=0;
+int show_profile=0; // F3 shows the frame profiler
+int num_levels=0;  // level files found by countLevels(), flag==num_levels+1 is the end screen
+
+/* Current level, loaded from levels/level<flag>.lvl by init(), the board it is
+   played on and the block's simulation state */
+Level lvl;
+Board board;
+SimState sim;
+int tiles_dirty=1; // set whenever board cells change, the tile pass then rebuilds its instances
+
+/* World position of a cube's centre on the board, the tile (i,j) is at x=6j-24, z=6i-24 */
+float cubeX (int cube)
+{
+	return 6.0f*sim.col[cube]-24;
+}
+float cubeZ (int cube)
+{
+	return 6.0f*sim.row[cube]-24;
+}
+
+/* The settled board baked into world space vertices, in chunks of
+   BOARD_CHUNK x BOARD_CHUNK cells with a VBO each that holds only the cells
+   with a tile. Once every tile has dropped in a chunk is one draw call,
+   chunks outside the view are culled whole, and a tile that changes - a
+   bridge, a broken fragile tile - only re-bakes its own chunk. A chunk is
+   baked when it first comes into the view's cell range, so like the tile
+   pass the cost follows the screen and not the board size. */
+#define BOARD_CHUNK 16
+
+struct BoardChunk {
+	VAO* Object; // NULL until the chunk is first baked with a tile
+	int Tiles;
+	int Dirty;   // a cell changed since the chunk was baked
+};
+
+struct BoardMesh {
+	int Baked;        // the chunks are laid out for the current level's board
+	int CellVertices; // vertices of a tile
+	int Rows, Cols;   // chunks
+	std::vector<BoardChunk> Chunks;
+	std::vector<PackedVertex> Vertices; // the chunk being baked
+} BoardBake;
+
+void createBoardMesh ()
+{
+	BoardBake.CellVertices = Tiles.batch[TILE_NORMAL].NumVertices;
+	BoardBake.Baked = 0;
+}
+
+/* Append the tile of cell (i,j) with the scale, position and checkerboard of
+   the instanced tile pass. Returns 1 if the cell has a tile. */
+int bakeCell (int i, int j)
+{
+	int type=board_cell(&board,i,j)->type;
+	if(type==0 || type==4 || type==7)
+		return 0;
+	int n=BoardBake.CellVertices;
+	const TileVertex* mesh=&Tiles.batch[type==6 ? TILE_FRAGILE : TILE_NORMAL].Mesh[0];
+	int alt=type==5 ? 0 : (i+j)%2;
+	for(int v=0;v<n;v++){
+		PackedVertex out;
+		out.pos[0]=mesh[v].pos[0]*1.5f+(j+1)*6-30;
+		out.pos[1]=mesh[v].pos[1]*0.4f;
+		out.pos[2]=mesh[v].pos[2]*1.5f+(i+1)*6-30;
+		memcpy(out.color, alt ? mesh[v].color_alt : mesh[v].color, sizeof(out.color));
+		BoardBake.Vertices.push_back(out);
+	}
+	return 1;
+}
+
+/* Rewrite chunk (ci,cj)'s VBO from the board's cells */
+void bakeChunk (int ci, int cj)
+{
+	BoardChunk* c=&BoardBake.Chunks[ci*BoardBake.Cols+cj];
+	BoardBake.Vertices.clear();
+	c->Tiles=0;
+	for(int i=ci*BOARD_CHUNK;i<min(board.rows,(ci+1)*BOARD_CHUNK);i++)
+		for(int j=cj*BOARD_CHUNK;j<min(board.cols,(cj+1)*BOARD_CHUNK);j++)
+			c->Tiles+=bakeCell(i,j);
+	c->Dirty=0;
+	if(!c->Object){
+		if(c->Tiles==0)
+			return;
+		c->Object=createMeshObject(GL_TRIANGLES, 0, genBuffer(), 1);
+	}
+	glstate_bind_array_buffer(c->Object->Buffer);
+	glBufferData (GL_ARRAY_BUFFER, BoardBake.Vertices.size()*sizeof(PackedVertex), c->Tiles ? &BoardBake.Vertices[0] : NULL, GL_DYNAMIC_DRAW);
+	c->Object->NumVertices=BoardBake.Vertices.size();
+}
+
+/* Lay the chunks out over a new level's board, none of them baked yet */
+void layoutBoardMesh ()
+{
+	for(size_t k=0;k<BoardBake.Chunks.size();k++)
+		if(BoardBake.Chunks[k].Object)
+			deleteObject(BoardBake.Chunks[k].Object);
+	BoardBake.Rows=(board.rows+BOARD_CHUNK-1)/BOARD_CHUNK;
+	BoardBake.Cols=(board.cols+BOARD_CHUNK-1)/BOARD_CHUNK;
+	BoardChunk empty = { NULL, 0, 1 };
+	BoardBake.Chunks.assign(BoardBake.Rows*BoardBake.Cols, empty);
+	BoardBake.Baked=1;
+}
+
+/* A cell of the board changed, its chunk is re-baked before it is drawn next */
+void boardMeshDirty (int i, int j)
+{
+	if(BoardBake.Baked)
+		BoardBake.Chunks[(i/BOARD_CHUNK)*BoardBake.Cols+j/BOARD_CHUNK].Dirty=1;
+}
+
+/* Show the switches' bridges on the board as the simulation has them */
+void syncBridges ()
+{
+	for(int k=0;k<lvl.num_switches;k++){
+		LevelSwitch* sw=&lvl.switches[k];
+		for(int c=0;c<sw->count;c++){
+			board_cell(&board,sw->cells[c][0],sw->cells[c][1])->type=sim_tile(&lvl,&sim,sw->cells[c][0],sw->cells[c][1]);
+			boardMeshDirty(sw->cells[c][0],sw->cells[c][1]);
+		}
+	}
+	tiles_dirty=1;
+}
+
+/* Roll the block one step, for the arrow keys and the on-screen arrows */
+void moveBlock (int move)
+{
+	if(flag>num_levels || sim.status!=SIM_PLAYING)
+		return;
+	if(soff==0)
+		audio_play(SOUND_ROLL);
+	moves++;
+
+	profile_begin(PROF_SIM);
+	sim_step(&lvl,&sim,move);
+	trace_instant(TRACE_MOVE,move,moves);
+	if(sim.events & SIM_EV_SWITCH){
+		if(soff==0)
+			audio_play(SOUND_STAR);
+		syncBridges();
+	}
+	if(sim.events & SIM_EV_BREAK){
+		board_cell(&board,sim.row[0],sim.col[0])->type=0;
+		boardMeshDirty(sim.row[0],sim.col[0]);
+		tiles_dirty=1;
+	}
+	profile_end(PROF_SIM);
+	if(sim.status==SIM_FELL){
+		trace_instant(TRACE_FALL,flag,attempts);
+		if(soff==0)
+			audio_play(SOUND_STAR);
+	}
+	if(sim.status==SIM_WON){
+		trace_instant(TRACE_WIN,flag,attempts);
+		if(soff==0)
+			audio_play(SOUND_FINISH);
+	}
+}
 /* Executed when a regular key is pressed/released/held-down */
 /* Prefered for Keyboard events */
 void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	// Function is called first on GLFW_PRESS.
+	trace_instant(TRACE_KEY, key, action);
+	replay_record(game_ticks, INPUT_KEY, key, action, 0, 0);
 
 	if (action == GLFW_RELEASE) {
 		switch (key) {
@@ -302,180 +429,17 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 	if(key==GLFW_KEY_H)
 		view=4;
 
-	if(key==GLFW_KEY_RIGHT && action==GLFW_PRESS && !disable){
-		if(soff==0)
-
-		system("mpg123  -vC sound1.mp3 &");
-		moves++;
-		stmove++;
-		if(l8f==0){
-
-		if(posx1==posx2 && posy2>posy1){
-			posx1+=6;
-			posx2+=12;
-			posy2-=6;
-
-		}
-
-		else if(posx1==posx2 && posy1>posy2){
-			posx1+=12;
-			posx2+=6;
-			posy1-=6;
-		}
-		else if(posx1>posx2 && posy1==posy2){
-			posx1+=6;
-			posx2+=12;
-			posy2+=6;
-		}
-		else if(posx2>posx1 && posy1==posy2){
-			posx2+=6;
-			posx1+=12;
-			posy1+=6;
-		}
-		else if(posx2==posx1 && posy1==posy2){
-			posx1+=6;
-			posx2+=6;
-			//posz2+=6;
-		}
-	}
-	else if(l8f==1){
-		posx2+=6;
-	}
-	else if(l8f==2){
-		posx1+=6;
-	}
-
-	}
-
-	else if(key==GLFW_KEY_LEFT && action==GLFW_PRESS && !disable){
-		moves++;
-		stmove++;
-		if(soff==0)
-
-		system("mpg123  -vC sound1.mp3 &");
-
-		if(l8f==0){
-
-		if(posx1==posx2 && posy2>posy1){
-			posx1-=6;
-			posx2-=12;
-			posy2-=6;
-
-		}
-
-		else if(posx1==posx2 && posy1>posy2){
-			posx1-=12;
-			posx2-=6;
-			posy1-=6;
-		}
-		else if(posx1>posx2 && posy1==posy2){
-			posx1-=12;
-			posx2-=6;
-			posy1+=6;
-		}
-		else if(posx2>posx1 && posy1==posy2){
-			posx1-=6;
-			posx2-=12;
-			posy2+=6;
-		}
-		else if(posx2==posx1 && posy1==posy2){
-			posx1-=6;
-			posx2-=6;
-			//posz2+=6;
-		}
-	}
-	else if(l8f==1){
-		posx2-=6;
-	}
-	else if(l8f==2)
-		posx1-=6;
-	}
-
-	else if(key==GLFW_KEY_UP && action==GLFW_PRESS && !disable){
-		moves++;
-		stmove++;
-		if(soff==0)
-
-		system("mpg123  -vC sound1.mp3 &");
-
-		if(l8f==0)
-		{
-		if(posz1==posz2 && posy2>posy1){
-			posz1-=6;
-			posz2-=12;
-			posy2-=6;
-
-		}
-
-		else if(posz1==posz2 && posy1>posy2){
-			posz1-=12;
-			posz2-=6;
-			posy1-=6;
-		}
-		else if(posz1>posz2 && posy1==posy2){
-			posz1-=12;
-			posz2-=6;
-			posy1+=6;
-		}
-		else if(posz2>posz1 && posy1==posy2){
-			posz1-=6;
-			posz2-=12;
-			posy2+=6;
-		}
-		else if(posz2==posz1 && posy1==posy2){
-			posz1-=6;
-			posz2-=6;
-			//posz2+=6;
-		}
-			}
-			else if(l8f==1){
-				posz2-=6;
-			}
-			else if(l8f==2)
-				posz1-=6;
-
-	}
-	if(key==GLFW_KEY_DOWN && action==GLFW_PRESS && !disable){
-		moves++;
-		stmove++;
-		if(soff==0)
-
-		system("mpg123  -vC sound1.mp3 &");
-
-		if(l8f==0){
-		if(posz1==posz2 && posy2>posy1){
-			posz1+=6;
-			posz2+=12;
-			posy2-=6;
-
-		}
-
-		else if(posz1==posz2 && posy1>posy2){
-			posz1+=12;
-			posz2+=6;
-			posy1-=6;
-		}
-		else if(posz1>posz2 && posy1==posy2){
-			posz1+=6;
-			posz2+=12;
-			posy2+=6;
-		}
-		else if(posz2>posz1 && posy1==posy2){
-			posz2+=6;
-			posz1+=12;
-			posy1+=6;
-		}
-		else if(posz2==posz1 && posy1==posy2){
-			posz1+=6;
-			posz2+=6;
-			//posz2+=6;
-		}
-	}
-	else if(l8f==1)
-		posz2+=6;
-	else if(l8f==2)
-		posz1+=6;
-
+	if(action==GLFW_PRESS){
+		if(key==GLFW_KEY_F3)
+			show_profile=!show_profile;
+		if(key==GLFW_KEY_RIGHT)
+			moveBlock(SIM_RIGHT);
+		else if(key==GLFW_KEY_LEFT)
+			moveBlock(SIM_LEFT);
+		else if(key==GLFW_KEY_UP)
+			moveBlock(SIM_UP);
+		else if(key==GLFW_KEY_DOWN)
+			moveBlock(SIM_DOWN);
 	}
 }
 
@@ -496,9 +460,53 @@ int mouse=0;
 int togtext=0;
 double lxg;
 		double lyg;
+/* Cursor position as the game sees it, logged when recording */
+void getCursor (GLFWwindow* window, double* x, double* y)
+{
+	if (replaying) {
+		*x = replay_x;
+		*y = replay_y;
+		return;
+	}
+	glfwGetCursorPos(window, x, y);
+	replay_record(game_ticks, INPUT_CURSOR, 0, 0, *x, *y);
+}
+/* The clickable parts of the title screen and the game's HUD */
+enum Button { BTN_ENTER, BTN_PASS, BTN_HELP, BTN_HELP_CLOSE, BTN_MENU, BTN_SOUND, BTN_END, BTN_RIGHT, BTN_LEFT, BTN_UP, BTN_DOWN };
+enum ButtonScreen { SCREEN_TITLE = 1, SCREEN_GAME = 2, SCREEN_GAME_MENU = 4 }; // the game menu is shown over the game
+
+/* Buttons are placed as drawn on the 1500x800 window the game opens with,
+   and kept as fractions of the window so they follow it when resized */
+void addButton (int id, unsigned screen, float x0, float y0, float x1, float y1)
+{
+	ui_add(id, screen, x0/1500, y0/800, x1/1500, y1/800);
+}
+
+void createButtons ()
+{
+	addButton(BTN_ENTER, SCREEN_TITLE, 593, 434, 860, 490);
+	addButton(BTN_PASS, SCREEN_TITLE, 593, 512, 860, 575);
+	addButton(BTN_HELP, SCREEN_TITLE, 593, 596, 860, 651);
+	addButton(BTN_HELP_CLOSE, SCREEN_TITLE, 264, 593, 441, 652);
+	addButton(BTN_MENU, SCREEN_GAME, 84, 21, 171, 65);
+	addButton(BTN_SOUND, SCREEN_GAME_MENU, 133, 268, 287, 294);
+	addButton(BTN_END, SCREEN_GAME_MENU, 160, 316, 220, 340);
+	addButton(BTN_RIGHT, SCREEN_GAME, 1371, 625, 1404, 656);
+	addButton(BTN_LEFT, SCREEN_GAME, 1225, 625, 1254, 656);
+	addButton(BTN_UP, SCREEN_GAME, 1300, 544, 1327, 573);
+	addButton(BTN_DOWN, SCREEN_GAME, 1300, 700, 1327, 734);
+}
+
 /* Executed when a mouse button is pressed/released */
 void mouseButton (GLFWwindow* window, int button, int action, int mods)
 {
+	// The event carries the cursor, a click is replayed where it was made
+	double x=replay_x, y=replay_y;
+	if (!replaying)
+		glfwGetCursorPos(window, &x, &y);
+	replay_record(game_ticks, INPUT_BUTTON, button, action, x, y);
+	if (action == GLFW_PRESS)
+		trace_instant(TRACE_MOUSE, (int)x, (int)y);
 	switch (button) {
 		case GLFW_MOUSE_BUTTON_LEFT:
 			if (action == GLFW_RELEASE)
@@ -530,230 +538,65 @@ void mouseButton (GLFWwindow* window, int button, int action, int mods)
 			lmouse=0;
 	}
 	if(lmouse1==1){
-		glfwGetCursorPos(window, &lxg, &lyg);
+		getCursor(window, &lxg, &lyg);
 
 	}
 	if(lmouse==1){
 		double lx;
 		double ly;
-		glfwGetCursorPos(window, &lx, &ly);
-		if(lx>593 && lx<860 && ly>434 && ly<490){
-			enter=1;
-
-		}
-		if(lx>593 && lx<860 && ly>512 && ly<575){
-			pass=1;
-		}
-		if(lx>593 && lx<860 && ly>596 && ly<651){
-			togtext=1;
-		}
-		if(lx>264 && lx<441 && ly>593 && ly<652){
-			togtext=0;
+		getCursor(window, &lx, &ly);
+		switch (ui_hit(SCREEN_TITLE, lx, ly)) {
+			case BTN_ENTER:
+				enter=1;
+				break;
+			case BTN_PASS:
+				pass=1;
+				break;
+			case BTN_HELP:
+				togtext=1;
+				break;
+			case BTN_HELP_CLOSE:
+				togtext=0;
+				break;
 		}
-		
 	}
 	if(mouse==1){
 		double lx;
 		double ly;
-		glfwGetCursorPos(window, &lx, &ly);
-		if(lx>84 && lx<171 && ly>21 && ly<65){
-			if(menu==0)
-			menu=1;
-			else if(menu==1)
-				menu=0;
-		}
-		if(lx>133 && lx<287 && ly>268 && ly<294 && menu==1){
-			if(soff==0)
-			soff=1;
-		else if(soff==1)
-			soff=0;
-		}
-		if(lx>160 && lx<220 && ly>316 && ly<340 && menu==1){
-			flag=9;
-		}
-		//-18.0f+posx1+l3+l6+l7, 3.0f+posy1+spo, -6.0f+posz1+r3+r4+r6+r7+r8+r9)); // glTra
-		if(lx>1371 && lx<1404 && ly>625 && ly<656){
-			if(soff==0)
-
-		system("mpg123  -vC sound1.mp3 &");
-		moves++;
-		stmove++;
-		if(l8f==0){
-
-		if(posx1==posx2 && posy2>posy1){
-			posx1+=6;
-			posx2+=12;
-			posy2-=6;
-
-		}
-
-		else if(posx1==posx2 && posy1>posy2){
-			posx1+=12;
-			posx2+=6;
-			posy1-=6;
-		}
-		else if(posx1>posx2 && posy1==posy2){
-			posx1+=6;
-			posx2+=12;
-			posy2+=6;
-		}
-		else if(posx2>posx1 && posy1==posy2){
-			posx2+=6;
-			posx1+=12;
-			posy1+=6;
-		}
-		else if(posx2==posx1 && posy1==posy2){
-			posx1+=6;
-			posx2+=6;
-			//posz2+=6;
-		}
-	}
-	else if(l8f==1){
-		posx2+=6;
-	}
-	else if(l8f==2){
-		posx1+=6;
-	}
-		}
-
-		else if(lx>1225 && lx<1254 && ly>625 && ly<656){
-			moves++;
-		stmove++;
-		if(soff==0)
-
-		system("mpg123  -vC sound1.mp3 &");
-
-		if(l8f==0){
-
-		if(posx1==posx2 && posy2>posy1){
-			posx1-=6;
-			posx2-=12;
-			posy2-=6;
-
-		}
-
-		else if(posx1==posx2 && posy1>posy2){
-			posx1-=12;
-			posx2-=6;
-			posy1-=6;
-		}
-		else if(posx1>posx2 && posy1==posy2){
-			posx1-=12;
-			posx2-=6;
-			posy1+=6;
-		}
-		else if(posx2>posx1 && posy1==posy2){
-			posx1-=6;
-			posx2-=12;
-			posy2+=6;
-		}
-		else if(posx2==posx1 && posy1==posy2){
-			posx1-=6;
-			posx2-=6;
-			//posz2+=6;
-		}
-	}
-	else if(l8f==1){
-		posx2-=6;
-	}
-	else if(l8f==2)
-		posx1-=6;
-	}
-
-
-else if(lx>1300 && lx<1327 && ly>544 && ly<573 ){
-	moves++;
-		stmove++;
-		if(soff==0)
-
-		system("mpg123  -vC sound1.mp3 &");
-
-		if(l8f==0)
-		{
-		if(posz1==posz2 && posy2>posy1){
-			posz1-=6;
-			posz2-=12;
-			posy2-=6;
-
-		}
-
-		else if(posz1==posz2 && posy1>posy2){
-			posz1-=12;
-			posz2-=6;
-			posy1-=6;
-		}
-		else if(posz1>posz2 && posy1==posy2){
-			posz1-=12;
-			posz2-=6;
-			posy1+=6;
-		}
-		else if(posz2>posz1 && posy1==posy2){
-			posz1-=6;
-			posz2-=12;
-			posy2+=6;
-		}
-		else if(posz2==posz1 && posy1==posy2){
-			posz1-=6;
-			posz2-=6;
-			//posz2+=6;
-		}
-			}
-			else if(l8f==1){
-				posz2-=6;
-			}
-			else if(l8f==2)
-				posz1-=6;
-}
-
-
-else if(lx>1300 && lx<1327 && ly>700 && ly<734){
-	moves++;
-		stmove++;
-		if(soff==0)
-
-		system("mpg123  -vC sound1.mp3 &");
-
-		if(l8f==0){
-		if(posz1==posz2 && posy2>posy1){
-			posz1+=6;
-			posz2+=12;
-			posy2-=6;
-
-		}
-
-		else if(posz1==posz2 && posy1>posy2){
-			posz1+=12;
-			posz2+=6;
-			posy1-=6;
-		}
-		else if(posz1>posz2 && posy1==posy2){
-			posz1+=6;
-			posz2+=12;
-			posy2+=6;
-		}
-		else if(posz2>posz1 && posy1==posy2){
-			posz2+=6;
-			posz1+=12;
-			posy1+=6;
-		}
-		else if(posz2==posz1 && posy1==posy2){
-			posz1+=6;
-			posz2+=6;
-			//posz2+=6;
+		getCursor(window, &lx, &ly);
+		switch (ui_hit(menu==1 ? SCREEN_GAME|SCREEN_GAME_MENU : SCREEN_GAME, lx, ly)) {
+			case BTN_MENU:
+				if(menu==0)
+				menu=1;
+				else if(menu==1)
+					menu=0;
+				break;
+			case BTN_SOUND:
+				if(soff==0)
+				soff=1;
+			else if(soff==1)
+				soff=0;
+				break;
+			case BTN_END:
+				flag=num_levels+1;
+				break;
+			case BTN_RIGHT:
+				moveBlock(SIM_RIGHT);
+				break;
+			case BTN_LEFT:
+				moveBlock(SIM_LEFT);
+				break;
+			case BTN_UP:
+				moveBlock(SIM_UP);
+				break;
+			case BTN_DOWN:
+				moveBlock(SIM_DOWN);
+				break;
 		}
 	}
-	else if(l8f==1)
-		posz2+=6;
-	else if(l8f==2)
-		posz1+=6;
 
 }
 
-
-		}
-
-	}
-
 int dis=0;
 float zoom=1;
 
@@ -766,6 +609,11 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
 	   is different from WindowSize */
 	glfwGetFramebufferSize(window, &fbwidth, &fbheight);
 
+	// The buttons are hit in window coordinates, like the cursor
+	int winwidth=width, winheight=height;
+	glfwGetWindowSize(window, &winwidth, &winheight);
+	ui_layout(winwidth, winheight);
+
 	GLfloat fov = 0.9f;
 
 	// sets the viewport of openGL renderer
@@ -788,7 +636,15 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
 
 }
 
-VAO *triangle,*triangle1,*triangle2,*triangle3, *rectangle,*cuboid[10][15],*cub1,*cub2,*circle,*rectangle1,*rectangle2,*rect[10][15],*level[7],*cuboid1[10][15],*dcub,*dcu,*circle1,*dcub1,*dcub2,*dcub3,*dcub4,*dcub5;
+VAO *triangle,*triangle1,*triangle2,*triangle3, *rectangle,*circle,*rectangle1,*rectangle2,*circle1;
+
+/* Cube palette entries - one per color set of the cube mesh */
+enum CubePalette { PAL_TILE, PAL_TILE_ALT, PAL_BLOCK, PAL_TELEPORT, PAL_SWITCH, PAL_SWITCH_HEAVY, PAL_FRAGILE, PAL_FRAGILE_ALT, PAL_COUNT };
+
+/* Mesh registry - the 36-vertex cube in every palette, drawn by the block and the markers */
+struct MeshRegistry {
+	VAO* Cube[PAL_COUNT]; // cube VAO for each palette entry, one packed VBO each
+} Meshes;
 
 // Creates the triangle object used in this sample code
 void createTriangle ()
@@ -831,15 +687,6 @@ void createRectangle ()
 		-1.2, 1,0, // vertex 4
 		-1.2,-1,0  // vertex 1
 	};
-	GLfloat display [] = {
-		0,0,0, // vertex 1
-		12,0,0, // vertex 2
-		12, 2,0, // vertex 3
-
-		12, 2,0, // vertex 3
-		0, 2,0, // vertex 4
-		0,0,0 
-	};
 
 	 GLfloat color_buffer_data [] = {
 		0,0,0, // color 1
@@ -874,24 +721,9 @@ void createRectangle ()
 	rectangle1 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, colordisplay, GL_FILL);
 	rectangle2 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, colordisplay1, GL_FILL);
 
-	for(int i=0;i<10;i++){
-		for(int j=0;j<15;j++)
-	rect[i][j] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-	}
-	for(int i=0;i<7;i++)
-		level[i]=create3DObject(GL_TRIANGLES, 6, display, colordisplay, GL_FILL);
-
 
 }
-float posy[10][10];
-void init();
-void level1();
-void level2();
-void level4();
-void level6();
-void level7();
-void level8();
-void level9();
+void init(const Level* parsed=NULL);
 
 
 
@@ -930,7 +762,6 @@ void createCircle()
 	circle1 = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data,color_buffer_data1,GL_FILL);
 
 }
-void level3();
 void createCuboid(){
 	GLfloat vertex_buffer_data [] = {
 		-2.0f,-2.0f,-2.0f, // triangle 1 : begin
@@ -1107,43 +938,17 @@ void createCuboid(){
 		color_buffer_data8[3*v+2] = 1;
 		}
 	}
-	for(int i=0;i<10;i++)
-		for(int j=0;j<15;j++){
-			if((i+j)%2==0)
-				cuboid[i][j] = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data1, GL_FILL);
-			else
-				cuboid[i][j] = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data2, GL_FILL);
-
-
-			cub1= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data3, GL_FILL);
-			cub2= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data3, GL_FILL);
-			dcu= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data1, GL_FILL);
-
-			dcub= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data5, GL_FILL);
-			dcub1= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data4, GL_FILL);
-			dcub2= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data5, GL_FILL);
-			dcub3= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data6, GL_FILL);
-			dcub4= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data7, GL_FILL);
-			dcub5= create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data8, GL_FILL);
+	const GLfloat* palette[PAL_COUNT] = { color_buffer_data1, color_buffer_data2, color_buffer_data3, color_buffer_data4,
+		color_buffer_data5, color_buffer_data6, color_buffer_data7, color_buffer_data8 };
 
+	for(int p=0;p<PAL_COUNT;p++)
+		Meshes.Cube[p] = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, palette[p], GL_FILL, 1);
 
-
-
-
-		}
-
-		for(int i=0;i<10;i++)
-		for(int j=0;j<15;j++){
-			if((i+j)%2==0)
-				cuboid1[i][j] = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data3,GL_LINE);
-			else
-				cuboid1[i][j] = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data3,GL_LINE);
-
-
-		}
+	createTileBatch(&Tiles.batch[TILE_NORMAL], 36, vertex_buffer_data, palette[PAL_TILE], palette[PAL_TILE_ALT], 10*15);
+	createTileBatch(&Tiles.batch[TILE_FRAGILE], 36, vertex_buffer_data, palette[PAL_FRAGILE], palette[PAL_FRAGILE_ALT], 10*15);
+	createBoardMesh();
 
 	init();
-	level1();
 }
 
 float camera_rotation_angle = 45;
@@ -1151,6 +956,7 @@ float rectangle_rotation = 0;
 
 void mousezoom(GLFWwindow* window, double xoffset, double yoffset)
 {
+	replay_record(game_ticks, INPUT_SCROLL, 0, 0, xoffset, yoffset);
 	if (yoffset==-1) { 
 		zoom/=1.1; 
 	}
@@ -1180,380 +986,392 @@ void mousezoom(GLFWwindow* window, double xoffset, double yoffset)
 }
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
-int a[10][15];
-void level1(){
-	for(int i=0;i<10;i++)
-		for(int j=0;j<10;j++)
-			a[i][j]=1;
-	for(int i=0;i<2;i++)
-		for(int j=0;j<10;j++)
-			a[i][j]=0;
-	for(int i=9;i>=8;i--)
-		for(int  j=0;j<10;j++)
-			a[i][j]=0;
-	a[6][7]=4;
-	a[6][0]=0;
-	a[6][2]=0;
-	a[6][1]=0;
-	a[6][3]=0;
-	a[6][4]=0;
-	int i=7;
-	for(int j=0;j<6;j++)
-		a[i][j]=0;
-	a[i][9]=0;
-	a[5][0]=0;
-	i=2;
-	for(int j=3;j<10;j++)
-		a[i][j]=0;
-	i=3;
-	for(int j=6;j<10;j++)
-		a[i][j]=0;
-	a[4][9]=0;
-	for(int i=0;i<10;i++)
-		for(int j=10;j<15;j++)
-			a[i][j]=0;
-}
-int l2tog=0,l2f=0;
-int l2togl=0,l2r=0;
-
-
-void level2(){
-	for(int i=0;i<10;i++)
-		for(int j=0;j<15;j++)
-			a[i][j]=1;
-	for(int i=0;i<3;i++)
-		for(int j=0;j<15;j++)
-			a[i][j]=0;
-	for(int i=8;i<10;i++)
-		for(int j=0;j<15;j++)
-			a[i][j]=0;
-	for(int i=3;i<8;i++){
-		a[i][4]=0;
-		a[i][5]=0;
-	}
-	int i=2;
-	for(int j=6;j<15;j++)
-		a[i][j]=1;
-	a[2][10]=0;
-	a[2][11]=0;
-	for(int i=3;i<8;i++)
-		for(int j=10;j<12;j++)
-			a[i][j]=0;
-	a[7][12]=0;
-	a[7][13]=0;
-	a[7][14]=0;
-	a[3][13]=4;
-	a[4][2]=2;
-	l2tog=0;
-	l2f=0;
-	a[3][8]=3;
-	l2r=0;
-	l2togl=0;
-
+/* Count the level files levels/level1.lvl, levels/level2.lvl, ... */
+int countLevels ()
+{
+	int n=0;
+	char path[64];
+	while(1){
+		sprintf(path,"levels/level%d.lvl",n+1);
+		FILE* f=fopen(path,"rb");
+		if(!f)
+			break;
+		fclose(f);
+		n++;
+	}
+	return n;
 }
-void level3(){
-	for(int i=0;i<10;i++){
-		for(int j=0;j<15;j++)
-			a[i][j]=1;
-	}
-	for(int i=0;i<4;i++)
-		for(int j=0;j<15;j++)
-			a[i][j]=0;
-	for(int i=8;i<10;i++)
-		for(int j=0;j<15;j++)
-			a[i][j]=0;
-		for(int i=6;i<8;i++)
-		for(int j=4;j<11;j++)
-			a[i][j]=0;
-		a[7][11]=0;
-		int i=3;
-		for(int j=6;j<15;j++)
-			a[i][j]=1;
-		a[4][4]=0;
-		a[4][5]=0;
-		a[4][9]=0;
-		a[4][10]=0;
-		a[5][9]=0;
-		a[5][10]=0;
-		a[3][13]=0;
-		a[3][14]=0;
-		a[4][13]=0;
-		a[4][14]=0;
-		a[6][13]=4;
 
+/* Start level flag from its file, or from parsed when the file was already read */
+void loadLevel (const Level* parsed)
+{
+	char path[64];
+	sprintf(path,"levels/level%d.lvl",flag);
+	if(parsed)
+		lvl=*parsed;
+	else if(load_level(path,&lvl)<0){
+		cout << "Error: Could not load level `" << path << "'" << endl;
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
 
+	board_load(&board,&lvl);
+	tiles_dirty=1;
+	BoardBake.Baked=0;
+	sim_start(&lvl,&sim);
+	trace_instant(TRACE_LEVEL,flag,attempts);
 }
-void level4(){
-	for(int i=0;i<10;i++){
-		for(int j=0;j<15;j++)
-			a[i][j]=1;
-	}
-	int i=0;
-	for(int j=0;j<15;j++)
-		a[i][j]=0;
-	for(int i=1;i<3;i++){
-		for(int j=0;j<3;j++)
-			a[i][j]=0;
-		for(int j=13;j<15;j++)
-			a[i][j]=0;
-	}
-	for(int i=3;i<6;i++)
-		for(int j=4;j<9;j++)
-			a[i][j]=0;
-		a[4][3]=0;
-		a[4][9]=0;
-		a[5][3]=0;
-		a[5][9]=0;
-		a[6][3]=0;
-		a[6][4]=0;
-		a[7][3]=0;
-		a[7][4]=0;
-
-		for(int i=8;i<10;i++)
-		for(int j=0;j<5;j++)
-			a[i][j]=0;
-		for(int i=8;i<10;i++)
-		for(int j=8;j<10;j++)
-			a[i][j]=0;
-		
-		a[8][6]=4;
-		a[8][13]=5;
-		a[6][8]=1;
-		a[6][9]=6;
-		a[7][8]=1;
-		a[7][9]=6;
-		for(int i=1;i<3;i++)
-			for(int j=3;j<10;j++)
-				a[i][j]=6;
-			for(int i=6;i<10;i++)
-			for(int j=9;j<15;j++)
-				a[i][j]=6;
-		a[8][13]=5;
 
+float spo,prev_spo;   // height the block drops in from at the start of a level
+float sink,prev_sink; // how far the block has sunk after falling off or reaching the goal
+int level_ticks; // steps played on this level, the tiles drop in with it
+int dis_ticks;   // steps the "LEVEL n" screen has been up
+void init(const Level* parsed){
+	spo=prev_spo=60;
+	sink=prev_sink=0;
+	level_ticks=0;
+	dis_ticks=0;
 
-}
-void level6(){
-	for(int i=0;i<10;i++){
-		for(int j=0;j<15;j++)
-			a[i][j]=1;
-	}
-	int i;
-	//int i=0;
-	//for(int j=0;j<15;j++)
-	//	a[i][j]=0;
-	for(int i=0;i<3;i++){
-		for(int j=0;j<5;j++)
-			a[i][j]=0;
-	}
-	a[1][6]=0;
-	a[1][7]=0;
-	a[2][6]=0;
-	a[2][7]=0;
-	a[3][6]=0;
-	for(int i=3;i<6;i++){
-		for(int j=7;j<11;j++)
-			a[i][j]=0;
-	}
-	a[6][8]=0;
-	a[6][7]=0;
-	a[5][11]=0;
-	for(i=6;i<9;i++)
-	for(int j=11;j<15;j++)
-		a[i][j]=0;
-	for(i=0;i<2;i++)
-	for(int j=11;j<15;j++)
-		a[i][j]=0;
-	a[2][13]=0,a[2][14]=0;
-	for(i=4;i<9;i++)
-	for(int j=0;j<4;j++)
-		a[i][j]=0;
-	for(i=6;i<9;i++)
-	for(int j=4;j<6;j++)
-		a[i][j]=0;
-	a[9][6]=0;
-	a[9][10]=0;
-	a[4][13]=4;
-	for(int j=0;j<6;j++)
-		a[9][j]=0;
-	for(int j=10;j<15;j++)
-		a[9][j]=0;
-}
-void level7(){
-	for(int i=0;i<10;i++){
-		for(int j=0;j<15;j++)
-			a[i][j]=1;
-	}
-	int i=0;
-	for(int j=0;j<15;j++)
-		a[i][j]=0;
-	i=9;
-	for(int j=0;j<15;j++)
-		a[i][j]=0;
-	for(int i=1;i<3;i++)
-		for(int j=0;j<8;j++)
-		a[i][j]=0;
-	for(int i=1;i<3;i++)
-		for(int j=12;j<15;j++)
-		a[i][j]=0;
-	i=3;
-		for(int j=3;j<8;j++)
-		a[i][j]=0;
-	a[3][9]=0;
-	a[3][10]=0;
-	a[4][9]=0;
-	for(int i=4;i<7;i++)
-		for(int j=10;j<12;j++)
-		a[i][j]=0;
-	for(int i=5;i<8;i++)
-		for(int j=3;j<7;j++)
-		a[i][j]=0;
-	for(int i=7;i<9;i++)
-		for(int j=9;j<15;j++)
-		a[i][j]=0;
-	a[4][13]=4;
-	a[5][9]=2;
+dis=1;
+if(flag<=num_levels)
+	loadLevel(parsed);
 
-}
-void level8(){
-	for(int i=0;i<10;i++){
-		for(int j=0;j<15;j++)
-			a[i][j]=0;
-	}
-	for(int i=4;i<7;i++){
-		for(int j=0;j<6;j++)
-			a[i][j]=1;
-	}
-	for(int i=1;i<10;i++){
-		for(int j=9;j<12;j++)
-			a[i][j]=1;
-	}
-	for(int i=4;i<7;i++){
-		for(int j=12;j<15;j++)
-			a[i][j]=1;
-	}
-	a[5][13]=4;
-	a[5][4]=7;
-l8f=0;
-}
-int sound=0;
-void level9(){
-	for(int i=0;i<10;i++){
-		for(int j=0;j<15;j++)
-			a[i][j]=0;
-	}
-	for(int i=3;i<6;i++){
-		for(int j=0;j<4;j++)
-			a[i][j]=1;
-	}
-	for(int i=3;i<6;i++){
-		for(int j=11;j<15;j++)
-			a[i][j]=1;
-	}
-	for(int i=5;i<6;i++){
-		for(int j=4;j<15;j++)
-			a[i][j]=1;
-	}
-	a[3][7]=1;
-	a[4][7]=1;
-	a[6][6]=1,a[7][6]=1,a[6][8]=1,a[7][8]=1,a[6][7]=4;
-	a[7][7]=1;
-	a[4][13]=7;
 
 }
-float spo;
-int attempts=1;
-void init(){
-	for(int i=0;i<15;i++)
-		for(int j=0;j<10;j++)
-			posy[i][j]=-60;
-
-sound=0;
-	//posy[0][0]=0;
-	spo=60;
-	posx1=0;
-	posx2=0;
-	posz1=0;
-	posz2=0;
-	posy1=0;
-	posy2=6;
-	disable=0;
 
-dis=1;
-stmove=0;
-if(flag==1){
-			level1();
-		}
-		if(flag==2)
-			level2();
-		if(flag==3)
-			level3();
-		if(flag==4)
-			level4();
-		if(flag==5)
-			level6();
-		if(flag==6)
-			level7();
-		if(flag==7)
-			level8();
-		if(flag==8)
-			level9();
+double current_time;
+unsigned start_ticks; // game_ticks when the current game started, for the TIME shown
+unsigned end_ticks;   // game_ticks when the end screen came up
+int score=0;
+int ending=0;  // the end screen is up
 
+/* The title screen starts the game once its enter button is clicked or a
+   level number is typed and entered */
+void titleScreen ()
+{
+	if(enter==1){
+		blo=1;
+		start_ticks=game_ticks;
+	}
+	if(ent==1 && ab[0]>='1' && ab[0]<='0'+num_levels){
+		flag=ab[0]-'0';
+		init();
+		blo=1;
+		start_ticks=game_ticks;
+	}
+}
 
+/* The game is won, lost or ended from the menu: the board and the score
+   are cleared and after 3 s the title screen comes back */
+void endScreen ()
+{
+	if(!ending){
+		ending=1;
+		end_ticks=game_ticks;
+		board_clear(&board);
+		if(attempts>3)
+			attempts=5;
+	}
+	moves=0;
+	score=0;
+	dis=1;
+	ent=0;
+	enter=0;
+	pass=0;
+	if(game_ticks-end_ticks>3*TICK_HZ){
+		ending=0;
+		flag=1;
+		blo=0;
+		init();
+	}
 }
 
-double current_time,utime=glfwGetTime();
-int flagdown=0;
+/* One fixed step of the game, 1/TICK_HZ s. Everything that moves with time
+   advances here and draw() only interpolates, so the game plays the same
+   at any frame rate and with vsync off. */
+void update ()
+{
+	game_ticks++;
+	prev_spo=spo;
+	prev_sink=sink;
+	if(flag>num_levels){
+		endScreen();
+		return;
+	}
+	if(blo==0){
+		titleScreen();
+		return;
+	}
+	if(blo!=1)
+		return;
+	if(dis==1){
+		if(++dis_ticks>=2*TICK_HZ)
+			dis=0;
+		return;
+	}
+
+	level_ticks++;
+	spo-=2;
+	if(spo<0)
+		spo=0;
+	if(sim.status==SIM_FELL){
+		sink+=40*TICK;
+		if(6*sim.height[0]-sink<-15){
+			view=0;
+			attempts++;
+			score-=10;
+			moves-=sim.moves;
+			if(attempts==4)
+				flag=num_levels+1; // out of attempts, the game is lost
+			init();
+		}
+	}
+	else if(sim.status==SIM_WON){
+		attempts=1;
+		sink+=40*TICK;
+		if(6*sim.height[0]-sink<-20){
+			flag++;
+			score+=100;
+			init();
+		}
+	}
+}
 
-glm::vec3 getRGBfromHue (int hue)
+/* Draw the flat marker cube sitting on a switch or teleport cell */
+void drawMarker (glm::mat4 VP, int row, int col, int palette)
 {
-  float intp;
-  float fracp = modff(hue/60.0, &intp);
-  float x = 1.0 - abs((float)((int)intp%2)+fracp-1.0);
-  float y=1;
-  if(hue==100){
-    return glm::vec3(1,1,1);
-
-  }
-else{
-  if (hue < 60)
-    return glm::vec3(1,x,0);
-  else if (hue < 120)
-    return glm::vec3(x,1,0);
-  else if (hue < 180)
-    return glm::vec3(0,1,x);
-  else if (hue < 240)
-    return glm::vec3(0,x,1);
-  else if (hue < 300)
-    return glm::vec3(x,0,1);
-  else
-    return glm::vec3(1,0,x);
+	Matrices.model = glm::mat4(1.0f);
+	glm::mat4 translateMarker = glm::translate (glm::vec3(0.0f+(col+1)*6-30, 0.0f, 0.0f+(row+1)*6-30)); // glTranslatef
+	glm::mat4 scaleMarker = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f));
+	Matrices.model *= translateMarker * scaleMarker;
+	glm::mat4 MVP = VP * Matrices.model; // MVP = p * V * M
 
+	drawObject(Meshes.Cube[palette], MVP);
 }
+
+/* Range of board cells whose tiles can be on screen. The view volume is
+   clipped to the height band the tiles move in and the box around what is
+   left is turned into rows and columns. Returns 0 if no cell is visible. */
+int visibleCells (glm::mat4 VP, int* row0, int* row1, int* col0, int* col1)
+{
+	glm::mat4 inv=glm::inverse(VP);
+	glm::vec3 corner[8];
+	for(int k=0;k<8;k++){
+		glm::vec4 p=inv*glm::vec4((k&1) ? 1 : -1, (k&2) ? 1 : -1, (k&4) ? 1 : -1, 1);
+		corner[k]=glm::vec3(p.x,p.y,p.z)/p.w;
+	}
+
+	float ymin=BOARD_DROP_HEIGHT-3, ymax=3;
+	float xmin=1e9, xmax=-1e9, zmin=1e9, zmax=-1e9;
+	int hit=0;
+	for(int k=0;k<8;k++)
+		for(int b=1;b<8;b<<=1){
+			if(k&b)
+				continue;
+			// Edge k -> k|b of the view volume, clipped to ymin <= y <= ymax
+			glm::vec3 p=corner[k], d=corner[k|b]-corner[k];
+			float t0=0, t1=1;
+			if(d.y==0){
+				if(p.y<ymin || p.y>ymax)
+					continue;
+			}
+			else{
+				float ta=(ymin-p.y)/d.y, tb=(ymax-p.y)/d.y;
+				t0=max(t0,min(ta,tb));
+				t1=min(t1,max(ta,tb));
+				if(t0>t1)
+					continue;
+			}
+			for(int e=0;e<2;e++){
+				glm::vec3 q=p+d*(e ? t1 : t0);
+				xmin=min(xmin,q.x); xmax=max(xmax,q.x);
+				zmin=min(zmin,q.z); zmax=max(zmax,q.z);
+			}
+			hit=1;
+		}
+	if(!hit)
+		return 0;
+
+	// Cell (i,j) covers x from 6j-27 to 6j-21 and z from 6i-27 to 6i-21
+	*col0=max(0,(int)ceil((xmin+21)/6));
+	*col1=min(board.cols-1,(int)floor((xmax+27)/6));
+	*row0=max(0,(int)ceil((zmin+21)/6));
+	*row1=min(board.rows-1,(int)floor((zmax+27)/6));
+	return *row0<=*row1 && *col0<=*col1;
 }
 
+int tiles_visible=0; // tiles in the instance lists after culling
+int tiles_culled=0;  // tiles of the visible cell range that were outside the view
 
-void display_string(GLFWwindow *window){
-	double lx;
-	double ly;
-	glfwGetCursorPos(window, &lx, &ly);
-	cout<<lx<<" "<<ly<<'\n';
+/* Put the tiles of the visible cells into the instance lists, each dropped in
+   by drop per cell from the corner. The cell range is only the box around the
+   view, so each tile is also tested against the frustum, which drops most of
+   the range for the follow cameras and the zoomed ortho views.
+   Returns 1 while a tile is still falling. */
+int collectTiles (glm::mat4 VP, float drop)
+{
+	int moving=0;
+	tiles_visible=tiles_culled=0;
+	beginTileBatches();
+	int row0,row1,col0,col1;
+	if(visibleCells(VP,&row0,&row1,&col0,&col1)){
+		Frustum frustum;
+		frustum_from(&frustum,VP);
+		for(int i=row0;i<=row1;i++){
+			BoardCell* cell=board_cell(&board,i,col0);
+			for(int j=col0;j<=col1;j++,cell++)
+			{
+				if(cell->type!=0 && cell->type!=4 && cell->type!=7){ 
+					cell->y=BOARD_DROP_HEIGHT+drop*(i+j);
+					if(cell->y>0)
+						cell->y=0;
+					if(cell->y<0 && i+j>0)
+						moving=1;
+					// The tile cube is 4 units scaled by 1.5, 0.4, 1.5
+					if(!frustum_box(&frustum,glm::vec3((j+1)*6-30,cell->y,(i+1)*6-30),glm::vec3(3,0.8f,3))){
+						tiles_culled++;
+						continue;
+					}
+					tiles_visible++;
+					if(cell->type==6)
+						addTileInstance(TILE_FRAGILE, 0.0f+(j+1)*6-30, cell->y, 0.0f+(i+1)*6-30, (i+j)%2);
+					else
+						addTileInstance(TILE_NORMAL, 0.0f+(j+1)*6-30, cell->y, 0.0f+(i+1)*6-30, cell->type==5 ? 0 : (i+j)%2);
+				}
+			}
+		}
+	}
+	trace_counter(TRACE_TILES,tiles_visible,tiles_culled);
+	return moving;
+}
 
+/* Draw the settled board from its chunks. The chunks over the view's cell
+   range are baked if they changed and tested against the frustum, the tiles
+   of the ones drawn and culled are counted like collectTiles() counts. */
+void drawBoardMesh (glm::mat4 VP)
+{
+	if(!BoardBake.Baked)
+		layoutBoardMesh();
+	tiles_visible=tiles_culled=0;
+	int row0,row1,col0,col1;
+	if(visibleCells(VP,&row0,&row1,&col0,&col1)){
+		Frustum frustum;
+		frustum_from(&frustum,VP);
+		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &VP[0][0]);
+		for(int ci=row0/BOARD_CHUNK;ci<=row1/BOARD_CHUNK;ci++)
+			for(int cj=col0/BOARD_CHUNK;cj<=col1/BOARD_CHUNK;cj++){
+				BoardChunk* c=&BoardBake.Chunks[ci*BoardBake.Cols+cj];
+				if(c->Dirty)
+					bakeChunk(ci,cj);
+				if(c->Tiles==0)
+					continue;
+				// From the first cell's tile to the last's, a tile is 6 across and 1.6 high
+				int i1=min(board.rows,(ci+1)*BOARD_CHUNK), j1=min(board.cols,(cj+1)*BOARD_CHUNK);
+				glm::vec3 lo(cj*BOARD_CHUNK*6-27,-0.8f,ci*BOARD_CHUNK*6-27), hi(j1*6-27,0.8f,i1*6-27);
+				if(!frustum_box(&frustum,(lo+hi)*0.5f,(hi-lo)*0.5f)){
+					tiles_culled+=c->Tiles;
+					continue;
+				}
+				tiles_visible+=c->Tiles;
+				draw3DObject(c->Object);
+			}
+	}
+	trace_counter(TRACE_TILES,tiles_visible,tiles_culled);
 }
+int flagdown=0;
+
 float camera_rotation_angle1=0;
-double utime1;
-double utime4=glfwGetTime();
-int score=0;
-int heli=0;
 void drag (GLFWwindow* window){
 	double lx1;
 	double ly1;
-	glfwGetCursorPos(window, &lx1, &ly1);
-	if(heli==1 && lmouse1==1){
-	camera_rotation_angle-=(lx1-lxg)/800;
-	camera_rotation_angle1-=(lx1-lxg)/800;
+	getCursor(window, &lx1, &ly1);
+	if(view!=0 && lmouse1==1){
+	camera_rotation_angle+=dragAngle(lx1,lxg);
+	camera_rotation_angle1+=dragAngle(lx1,lxg);
 }
 	}
-void draw ()
+/* Camera of the 2D screens and the HUD text */
+const glm::mat4 hudView = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0));
+
+/* Matrices of the board camera. They only change with the view, the zoom, the
+   rotation of view 4 or, for the views that follow it, the block's cell. */
+struct CameraCache {
+	int valid;
+	int view, col, row;
+	float zoom, angle;
+	glm::mat4 view_matrix, projection, VP;
+	int version; // bumped on every recompute
+} Camera;
+
+void updateCamera ()
+{
+	int follow=(view==1 || view==3);
+	int col=follow ? sim.col[0] : 0, row=follow ? sim.row[0] : 0;
+	if(Camera.valid && Camera.view==view && Camera.zoom==zoom && Camera.angle==camera_rotation_angle
+		&& Camera.col==col && Camera.row==row)
+		return;
+	Camera.valid=1;
+	Camera.view=view;
+	Camera.zoom=zoom;
+	Camera.angle=camera_rotation_angle;
+	Camera.col=col;
+	Camera.row=row;
+	Camera.version++;
+
+	if(view==0){
+		Camera.projection = glm::ortho((float)(-100.0f/zoom), (float)(100.0f/zoom), (float)(-50.0f/zoom), (float)(50.0f/zoom), 0.1f, 500.0f);
+		Camera.view_matrix = glm::lookAt(glm::vec3(-30,70,60), glm::vec3(0,0,0), glm::vec3(0,1,0));
+	}
+	if(view==1){
+		Camera.projection = glm::perspective(0.9f+0.6f, (GLfloat) 1500 / (GLfloat) 800, 0.1f, 500.0f);
+		Camera.view_matrix = glm::lookAt(glm::vec3(cubeX(0)+10,15,cubeZ(0)+2), glm::vec3(30,0,10), glm::vec3(0,1,0));
+	}
+	if(view==2){
+		Camera.projection = glm::ortho(-100.0f,100.0f,-50.0f,50.0f,0.1f, 500.0f);
+		Camera.view_matrix = glm::lookAt(glm::vec3(0,90,0), glm::vec3(0,0,0), glm::vec3(0,0,-1));
+	}
+	if(view==3){
+		Camera.projection = glm::perspective(0.9f+0.3f, (GLfloat) 1500 / (GLfloat) 800, 0.1f, 500.0f);
+		Camera.view_matrix = glm::lookAt(glm::vec3(cubeX(0)-15,24,cubeZ(0)-2), glm::vec3(30,0,10), glm::vec3(0,1,0));
+	}
+	if(view==4){
+		Camera.projection = glm::ortho(-100.0f/zoom,100.0f/zoom,-50.0f/zoom,50.0f/zoom,0.1f, 500.0f);
+		Camera.view_matrix = glm::lookAt(glm::vec3(-30*cos(camera_rotation_angle*M_PI/180),70,60*sin(camera_rotation_angle*M_PI/180)), glm::vec3(0,0,0), glm::vec3(0,1,0));
+	}
+	Camera.VP = Camera.projection * Camera.view_matrix;
+}
+
+/* F3 overlay: min/avg/p99 of every phase over the last PROFILE_WINDOW frames, CPU then GPU */
+void drawProfileHud ()
+{
+	static glm::mat4 VP = glm::ortho(-100.0f,100.0f,-50.0f,50.0f,0.1f,500.0f) * hudView;
+	glm::vec3 color (1,1,0.6f);
+
+	char line[160];
+	for(int p=-1;p<PROF_PHASES;p++){
+		if(p<0)
+			sprintf(line,"ms      cpu min  avg   p99    gpu min  avg   p99");
+		else{
+			ProfileStats cpu,gpu;
+			profile_stats(p,0,&cpu);
+			profile_stats(p,1,&gpu);
+			int n=sprintf(line,"%-6s %6.2f %5.2f %5.2f",profile_names[p],cpu.min,cpu.avg,cpu.p99);
+			if(gpu.samples)
+				sprintf(line+n,"   %6.2f %5.2f %5.2f",gpu.min,gpu.avg,gpu.p99);
+		}
+		glm::mat4 MVP = VP * glm::translate(glm::vec3(-98,45-4.5f*(p+1),0)) * glm::scale(glm::vec3(3.5f,3.5f,3.5f));
+		drawText(line, MVP, color);
+	}
+
+	// GL state calls of the last frame, made/skipped, and the render queue
+	int n=sprintf(line,"tiles %d queue %d/%d gl set/skip",tiles_visible,renderq_last.items,renderq_last.batches);
+	for(int k=0;k<GLS_KINDS;k++)
+		n+=sprintf(line+n," %s %d/%d",glstate_names[k],glstate.last.changes[k],glstate.last.skipped[k]);
+	glm::mat4 MVP = VP * glm::translate(glm::vec3(-98,45-4.5f*(PROF_PHASES+1),0)) * glm::scale(glm::vec3(3.5f,3.5f,3.5f));
+	drawText(line, MVP, color);
+}
+
+void draw (float alpha)
 {
 
 	// clear the color and depth in the frame buffer
@@ -1562,67 +1380,17 @@ void draw ()
 
 	// use the loaded shader program
 	// Don't change unless you know what you are doing
-	glUseProgram (programID);
-
-	// Eye - Location of camera. Don't change unless you are sure!!
-	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-	// Target - Where is the camera looking at.  Don't change unless you are sure!!
-	glm::vec3 target (0, 0, 0);
-	// Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-	glm::vec3 up (0, 1, 0);
+	glstate_use_program(programID);
 
 	//if(zoom<0)
 	//Matrices.view = glm::lookAt(glm::vec3(-30,70,60), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
 
 	//Matrices.projection = glm::perspective(0.9f+zoom, (GLfloat) 1500 / (GLfloat) 800, 0.1f, 500.0f);
-	if(attempts==4){
-		flag=9;
-		utime1=glfwGetTime();
-
-	}
-
-	if(dis==0)
-	Matrices.view = glm::lookAt(glm::vec3(-30,70,60), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-	if(dis==1 || blo==0)
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); 
-	
-	if(view==0){
-	Matrices.view = glm::lookAt(glm::vec3(-30,70,60), glm::vec3(0,0,0), glm::vec3(0,1,0));
-	Matrices.projection = glm::ortho((float)(-100.0f/zoom), (float)(100.0f/zoom), (float)(-50.0f/zoom), (float)(50.0f/zoom), 0.1f, 500.0f);
-	heli=0;
-
-}
-	if(view==1){
-		heli=1;
-	//Matrices.projection = glm::ortho(-100.0f,100.0f,-50.0f,50.0f,0.1f, 500.0f);
-	//glm::mat4 translateTriangle1 = glm::translate (glm::vec3(-18.0f+posx1+l3+l6+l7, 3.0f+posy1+spo, -6.0f+posz1+r3+r4+r6+r7+r8+r9)); // glTranslatef
-
-	Matrices.projection = glm::perspective(0.9f+0.6f, (GLfloat) 1500 / (GLfloat) 800, 0.1f, 500.0f);
-
-	Matrices.view = glm::lookAt(glm::vec3(-8+posx1+l3+l6+l7,15,-4+posz1+r3+r4+r6+r7+r8+r9), glm::vec3(30,0,10), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-	}
-	if(view==2){
-		heli=1;
-	//Matrices.projection = glm::perspective(0.9f, (GLfloat) 1500 / (GLfloat) 800, 0.1f, 500.0f);
-	Matrices.projection = glm::ortho(-100.0f,100.0f,-50.0f,50.0f,0.1f, 500.0f);
-	
-	Matrices.view = glm::lookAt(glm::vec3(0,90,0), glm::vec3(0,0,0), glm::vec3(0,0,-1)); 
-	}
-	if(view==3){
-		heli=1;
-	Matrices.projection = glm::perspective(0.9f+0.3f, (GLfloat) 1500 / (GLfloat) 800, 0.1f, 500.0f);
-	Matrices.view = glm::lookAt(glm::vec3(-33+posx1+l3+l6+l7,24,-8+posz1+r3+r4+r6+r7+r8+r9), glm::vec3(30,0,10), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-	} 
-    if(view==4){
-    	heli=1;
-	Matrices.projection = glm::ortho(-100.0f/zoom,100.0f/zoom,-50.0f/zoom,50.0f/zoom,0.1f, 500.0f);
-
-	Matrices.view = glm::lookAt(glm::vec3(-30*cos(camera_rotation_angle*M_PI/180),70,60*sin(camera_rotation_angle*M_PI/180)), glm::vec3(0,0,0), glm::vec3(0,1,0));
-	} 
-	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-	//  Don't change unless you are sure!!
-	glm::mat4 VP = Matrices.projection * Matrices.view;
+	// Views 1-4 can be rotated with the mouse
+	updateCamera();
+	Matrices.view = Camera.view_matrix;
+	Matrices.projection = Camera.projection;
+	glm::mat4 VP = Camera.VP;
 
 	// Send our transformation to the currently bound shader, in the "MVP" uniform
 	// For each model you render, since the MVP will be different (at least the M part)
@@ -1632,17 +1400,11 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	// Compute Camera matrix (view)
 	// Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
 	//  Don't change unless you are sure!!
-	if(flag==9){
+	if(flag>num_levels){
 		
-		for(int i=0;i<10;i++)
-			for(int j=0;j<15;j++)
-				a[i][j]=0;
-moves=0;
-score=0;
 float fontScaleValue = 36;
 int fontScale=150;
 	glm::vec3 fontColor1= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_strl[30],level_strl1[30];
@@ -1650,14 +1412,12 @@ int fontScale=150;
 	if(attempts<=3)
 	sprintf(level_strl,"YOU WIN");
 	if(attempts>3){
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); 
+Matrices.view = hudView; 
 	//attempts=5;
 	sprintf(level_strl,"YOU LOOSE");
-	attempts=5;
 }
 
 
-glUseProgram(fontProgramID);
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -1665,33 +1425,16 @@ glUseProgram(fontProgramID);
 	glm::mat4 scaleText = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText * scaleText);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor1[0]);
-	GL3Font.font->Render(level_strl);
-	dis=1;
-	ent=0;
-	enter=0;
-	pass=0;
-	l3=0,r3=0,l6=0,r6=0,l7=0,r7=0,r8=0,r9=0;
-	double ctime=glfwGetTime();
-	if(ctime-utime1>3){
-	//	re=1;
-		flag=1;
-		blo=0;
-		init();
-
-	}
+	drawText(level_strl, MVP, fontColor1);
 		
 
 	}
 
 	if(blo==0){
-		double ctime4=glfwGetTime();
 		float fontScaleValue = 36;
 int fontScale=150;
 	glm::vec3 fontColor1= getRGBfromHue(fontScale);
-	glUseProgram(programID);
+	glstate_use_program(programID);
 
 
 	char level_strl[30],level_strl1[30];
@@ -1706,11 +1449,10 @@ int fontScale=150;
 
 
 
-	glUseProgram(fontProgramID);
 
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); 
-	glUseProgram(programID);
+Matrices.view = hudView; 
+	glstate_use_program(programID);
 	Matrices.model = glm::mat4(1.0f);
 					
 glm::mat4 translateTriangle2 = glm::translate (glm::vec3(-5,-8,0)); // glTranslatef
@@ -1721,9 +1463,7 @@ glm::mat4 translateTriangle2 = glm::translate (glm::vec3(-5,-8,0)); // glTransla
 				Matrices.model *= triangleTransform2; 
 				MVP = Matrices.projection * Matrices.view * Matrices.model; // MVP = p * V * M
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(rectangle);
+				drawObject(rectangle, MVP);
 // Fixed camera for 2D (ortho) in XY plane
 Matrices.model = glm::mat4(1.0f);
 					
@@ -1735,10 +1475,9 @@ glm::mat4 translateTriangle1 = glm::translate (glm::vec3(-3,-8,0)); // glTransla
 				Matrices.model *= triangleTransform1; 
 				MVP = Matrices.projection * Matrices.view * Matrices.model; // MVP = p * V * M
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
 				if(!togtext)
 
-				draw3DObject(rectangle1);
+				drawObject(rectangle1, MVP, 1);
 
 
 				Matrices.model = glm::mat4(1.0f);
@@ -1751,9 +1490,8 @@ glm::mat4 translateTriangle3 = glm::translate (glm::vec3(-3,-18,0)); // glTransl
 				Matrices.model *= triangleTransform3; 
 				MVP = Matrices.projection * Matrices.view * Matrices.model; // MVP = p * V * M
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
 				if(!togtext)
-				draw3DObject(rectangle1);
+				drawObject(rectangle1, MVP, 1);
 
 				Matrices.model = glm::mat4(1.0f);
 					
@@ -1765,10 +1503,8 @@ glm::mat4 translateTriangle4 = glm::translate (glm::vec3(-3,-28,0)); // glTransl
 				Matrices.model *= triangleTransform4; 
 				MVP = Matrices.projection * Matrices.view * Matrices.model; // MVP = p * V * M
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
 				if(!togtext)
-				draw3DObject(rectangle1);
+				drawObject(rectangle1, MVP, 1);
 
 			Matrices.model = glm::mat4(1.0f);
 					
@@ -1780,11 +1516,8 @@ glm::mat4 translateTriangle5 = glm::translate (glm::vec3(-53,-28,0)); // glTrans
 				Matrices.model *= triangleTransform5; 
 				MVP = Matrices.projection * Matrices.view * Matrices.model; // MVP = p * V * M
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
 				if(togtext)
-				draw3DObject(rectangle1);
-	glUseProgram(fontProgramID);
+				drawObject(rectangle1, MVP, 1);
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -1792,10 +1525,7 @@ glm::mat4 translateTriangle5 = glm::translate (glm::vec3(-53,-28,0)); // glTrans
 	glm::mat4 scaleText = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText * scaleText);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor1[0]);
-	GL3Font.font->Render(level_strl);
+	drawText(level_strl, MVP, fontColor1);
 	int fontScale1=5;
 	fontScaleValue=8;
 	glm::vec3 fontColor= getRGBfromHue(fontScale1);
@@ -1805,11 +1535,8 @@ glm::mat4 translateTriangle5 = glm::translate (glm::vec3(-53,-28,0)); // glTrans
 	glm::mat4 scaleText1 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText1 * scaleText1);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor[0]);
 	if(!togtext)
-	GL3Font.font->Render(level_strl1);
+	drawText(level_strl1, MVP, fontColor);
 
 	glm::vec3 fontColor2= getRGBfromHue(fontScale1);
 
@@ -1818,11 +1545,8 @@ glm::mat4 translateTriangle5 = glm::translate (glm::vec3(-53,-28,0)); // glTrans
 	glm::mat4 scaleText2 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText2 * scaleText2);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor2[0]);
 	if(!togtext)
-	GL3Font.font->Render(level_strl2);
+	drawText(level_strl2, MVP, fontColor2);
 
 
 	
@@ -1834,11 +1558,8 @@ glm::mat4 translateTriangle5 = glm::translate (glm::vec3(-53,-28,0)); // glTrans
 	glm::mat4 scaleText3 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText3 * scaleText3);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor3[0]);
 	if(!togtext)
-	GL3Font.font->Render(level_strl3);
+	drawText(level_strl3, MVP, fontColor3);
 fontScale1=100;
 	fontScaleValue=6;
 glm::vec3 fontColor4= getRGBfromHue(fontScale1);
@@ -1848,11 +1569,8 @@ glm::vec3 fontColor4= getRGBfromHue(fontScale1);
 	glm::mat4 scaleText4 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText4 * scaleText4);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor4[0]);
 	if(togtext)
-	GL3Font.font->Render(level_strl4);
+	drawText(level_strl4, MVP, fontColor4);
 
 
 fontScale1=0;
@@ -1864,117 +1582,16 @@ glm::vec3 fontColor5= getRGBfromHue(fontScale1);
 	glm::mat4 scaleText5 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText5 * scaleText5);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor5[0]);
 	if(togtext)
-	GL3Font.font->Render(level_strl5);
-
-	//double ctime=glfwGetTime();
-	if(enter==1){
-		blo=1;
-		
-		utime=glfwGetTime();
-		utime1=glfwGetTime();
-
-	}
-	if(ent==1){
-			//cout<<"yes";
-		if(ab[0]=='1'){
-				flag=1;
-				level1();
-				blo=1;
-		utime1=glfwGetTime();
-		utime=glfwGetTime();
-
-			}
-			if(ab[0]=='2'){
-				flag=2;
-				level2();
-				blo=1;
-		utime1=glfwGetTime();
-		utime=glfwGetTime();
-
-			}
-			if(ab[0]=='3'){
-				flag=3;
-				level3();
-				blo=1;
-		utime1=glfwGetTime();
-		utime=glfwGetTime();
-		l3=0;
-			r3=18;
-
-			}
-			if(ab[0]=='4'){
-				flag=4;
-				level4();
-				blo=1;
-		utime1=glfwGetTime();
-		utime=glfwGetTime();
-		l3=0;
-			r3=18;
-
-
-			}
-			if(ab[0]=='5'){
-				flag=5;
-				level6();
-				blo=1;
-		utime1=glfwGetTime();
-		utime=glfwGetTime();
-		l3=-6;
-			r3=0;
-
-
-			}
-			if(ab[0]=='6'){
-				flag=6;
-				level7();
-				blo=1;
-		utime1=glfwGetTime();
-		utime=glfwGetTime();
-		l3=0;
-			r3=18;
-			l6=-6;
-			r6=-18;
-
-			}
-			if(ab[0]=='7'){
-				flag=7;
-				level8();
-				blo=1;
-		utime1=glfwGetTime();
-		utime=glfwGetTime();
-		l3=0;
-			r3=18;
-			l6=-6;
-			r6=-18;
-			l7=6;
-			r7=6;
-
-			}
-			if(ab[0]=='8'){
-				flag=8;
-				level9();
-				blo=1;
-		utime1=glfwGetTime();
-		utime=glfwGetTime();
-		l3=0;
-			r3=18;
-l6=0;
-			r6=-12;
-
-			}
+	drawText(level_strl5, MVP, fontColor5);
 
-		}
 
 
 	}
 
 		
 	if(pass==1 && blo==0){
-	glUseProgram(programID);
+	glstate_use_program(programID);
 
 		Matrices.model = glm::mat4(1.0f);
 					
@@ -1986,16 +1603,13 @@ glm::mat4 translateTriangle1 = glm::translate (glm::vec3(33,-22,0)); // glTransl
 				Matrices.model *= triangleTransform1; 
 				MVP = Matrices.projection * Matrices.view * Matrices.model; // MVP = p * V * M
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(rectangle1);
+				drawObject(rectangle1, MVP, 1);
 
 				float fontScaleValue = 12 ;
 int fontScale=280;
 	glm::vec3 fontColor= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2003,25 +1617,20 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	glm::mat4 scaleText = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText * scaleText);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor[0]);
-	GL3Font.font->Render(ab);
+	drawText(ab, MVP, fontColor);
 				
 				
 
 	}
 	if(dis==0 && blo==1){
-		int ti=glfwGetTime();
+		int ti=(game_ticks-start_ticks)/TICK_HZ;
 		int ti1,ti2,ti3;
-		ti-=utime1;
 		ti1=ti/3600;
 		ti2=ti/60;
 		ti3=(ti-(ti2*60));
 float fontScaleValue = 12 ;
 int fontScale=280;
 	glm::vec3 fontColor= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_strl[30];
@@ -2030,7 +1639,7 @@ int fontScale=280;
 
 
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2038,10 +1647,7 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	glm::mat4 scaleText = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText * scaleText);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor[0]);
-	GL3Font.font->Render(level_strl);
+	drawText(level_strl, MVP, fontColor);
 
 
 
@@ -2049,7 +1655,6 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	 fontScaleValue = 12 ;
  fontScale=280;
 	glm::vec3 fontColor3= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_strl3[30];
@@ -2058,7 +1663,7 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 
 
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2066,12 +1671,9 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	glm::mat4 scaleText4 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText4 * scaleText4);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor3[0]);
-	GL3Font.font->Render(level_strl3);
+	drawText(level_strl3, MVP, fontColor3);
 
-glUseProgram(programID);
+glstate_use_program(programID);
 	Matrices.model = glm::mat4(1.0f);
 					
 glm::mat4 translateTriangle1 = glm::translate (glm::vec3(-83,44.5,0)); // glTranslatef
@@ -2082,15 +1684,12 @@ glm::mat4 translateTriangle1 = glm::translate (glm::vec3(-83,44.5,0)); // glTran
 				Matrices.model *= triangleTransform1; 
 				MVP = Matrices.projection * Matrices.view * Matrices.model; // MVP = p * V * M
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(rectangle2);
+				drawObject(rectangle2, MVP);
 
 
 	fontScaleValue = 8 ;
  fontScale=100;
 	glm::vec3 fontColor4= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_strl4[30];
@@ -2099,7 +1698,7 @@ glm::mat4 translateTriangle1 = glm::translate (glm::vec3(-83,44.5,0)); // glTran
 
 
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2107,13 +1706,10 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	glm::mat4 scaleText5 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText5 * scaleText5);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor4[0]);
-	GL3Font.font->Render(level_strl4);
+	drawText(level_strl4, MVP, fontColor4);
 	if(menu==1){
 		//char level_strl5[30];
-		glUseProgram(programID);
+		glstate_use_program(programID);
 	Matrices.model = glm::mat4(1.0f);
 					
 glm::mat4 translateTriangle1 = glm::translate (glm::vec3(-73,6,0)); // glTranslatef
@@ -2124,13 +1720,10 @@ glm::mat4 translateTriangle1 = glm::translate (glm::vec3(-73,6,0)); // glTransla
 				Matrices.model *= triangleTransform1; 
 				MVP = Matrices.projection * Matrices.view * Matrices.model; // MVP = p * V * M
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(rectangle);
+				drawObject(rectangle, MVP, 1);
 fontScaleValue = 6 ;
  fontScale=100;
 	glm::vec3 fontColor4= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_strl4[30];
@@ -2140,7 +1733,7 @@ fontScaleValue = 6 ;
 
 
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2148,16 +1741,12 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	glm::mat4 scaleText5 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText5 * scaleText5);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor4[0]);
-	GL3Font.font->Render(level_strl4);
+	drawText(level_strl4, MVP, fontColor4);
 
 
 fontScaleValue = 6 ;
  fontScale=100;
 	glm::vec3 fontColor5= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_strl5[30];
@@ -2166,7 +1755,7 @@ fontScaleValue = 6 ;
 
 
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2174,16 +1763,12 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	glm::mat4 scaleText6 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText6 * scaleText6);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor5[0]);
-	GL3Font.font->Render(level_strl5);
+	drawText(level_strl5, MVP, fontColor5);
 
 
 	fontScaleValue = 6 ;
  fontScale=100;
 	glm::vec3 fontColor6= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_strl6[30];
@@ -2192,7 +1777,7 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 
 
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2200,16 +1785,12 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	glm::mat4 scaleText7 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText7 * scaleText7);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor6[0]);
-	GL3Font.font->Render(level_strl6);
+	drawText(level_strl6, MVP, fontColor6);
 
 
 	fontScaleValue = 6 ;
  fontScale=100;
 	glm::vec3 fontColor7= getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_strl7[30];
@@ -2218,7 +1799,7 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 
 
 
-Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2226,10 +1807,7 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 	glm::mat4 scaleText8 = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText8 * scaleText8);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor7[0]);
-	GL3Font.font->Render(level_strl7);
+	drawText(level_strl7, MVP, fontColor7);
 
 
 	}
@@ -2240,27 +1818,19 @@ Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)
 
 
 	if(dis==1 && blo==1){
-double ctime=glfwGetTime();
-		if(ctime - utime > 2){
-			utime=glfwGetTime();
-			dis=0;
-
-		}
-
 	// Send our transformation to the currently bound shader, in the "MVP" uniform
 	// For each model you render, since the MVP will be different (at least the M part)
 	//  Don't change unless you are sure!!
 		int fontScale=1;
 float fontScaleValue = 36 ;
 	glm::vec3 fontColor = getRGBfromHue(fontScale);
-	glUseProgram(fontProgramID);
 
 
 	char level_str[30];
 	sprintf(level_str,"LEVEL: %d",flag);
 	
 
-	Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+	Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2268,122 +1838,38 @@ float fontScaleValue = 36 ;
 	glm::mat4 scaleText = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText * scaleText);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor[0]);
-	if(flag<9)
-	GL3Font.font->Render(level_str);
+	if(flag<=num_levels)
+	drawText(level_str, MVP, fontColor);
 	}
 	else if(dis==0 && blo==1){
-	glUseProgram (programID);
-
-
-
-	// Load identity to model matrix
-	for(int i=0;i<10;i++){
-		for(int j=0;j<15;j++)
-		{
-			if(a[i][j]==1 ||a[i][j]==2 || a[i][j]==3 ||a[i][j]==6){ 
-
-
-				Matrices.model = glm::mat4(1.0f);
-				posy[i][j]+=((i+j)/1.5);
-				if(posy[i][j]>0)
-					posy[i][j]=0;
-				if(flag==4 && a[i][j]==6){
-
-
-
-					if((i+j)%2==0){
-						Matrices.model = glm::mat4(1.0f);
-					
-glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(j+1)*6-30, 0.0+posy[i][j], 0.0f+(i+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle1 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform1 = translateTriangle1 * rotateTriangle1*scaleTriangle1;
-				Matrices.model *= triangleTransform1; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(dcub4);
-			}
-
-
-			else
-			{
-				Matrices.model = glm::mat4(1.0f);
-					
-glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(j+1)*6-30, 0.0+posy[i][j], 0.0f+(i+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle1 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform1 = translateTriangle1 * rotateTriangle1*scaleTriangle1;
-				Matrices.model *= triangleTransform1; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(dcub5);
-			}
-				Matrices.model = glm::mat4(1.0f);
-
-glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(13+1)*6-30, 0.0f+posy[i][j], 0.0f+(8+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle1 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslate
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform1 = translateTriangle1 * rotateTriangle1*scaleTriangle1;
-				Matrices.model *= triangleTransform1; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(dcu);
-
-				}
-				else{
-				glm::mat4 translateTriangle = glm::translate (glm::vec3(0.0f+(j+1)*6-30, 0.0f+posy[i][j], 0.0f+(i+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform = translateTriangle * rotateTriangle*scaleTriangle;
-				Matrices.model *= triangleTransform; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(cuboid[i][j]);
-				}
-				
-	/*			Matrices.model = glm::mat4(1.0f);
-
-glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(j+1)*6-30, 0.0f+posy[i][j], 0.0f+(i+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle1 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform1 = translateTriangle1 * rotateTriangle1*scaleTriangle1;
-				Matrices.model *= triangleTransform1; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
+	glstate_use_program(programID);
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
 
-				draw3DObject(rect[i][j]);
-*/
 
-			}
+	// While the tiles drop in, collect the visible ones into per-kind instance lists, one instanced draw per kind.
+	// Only the cells inside the view are walked, so the cost follows the screen and not the board size.
+	// The lists are kept while the camera and the board stay put and no tile is still dropping in.
+	// Once the slowest tiles, next to the near corner, have landed the board is drawn from its baked chunks, one draw call per chunk in view.
+	profile_begin(PROF_TILES);
+	static int tiles_camera=-1, tiles_moving=1;
+	float drop=(level_ticks+alpha)/1.5f;
+	if(BOARD_DROP_HEIGHT+drop>=0){
+		drawBoardMesh(VP);
+	}
+	else {
+		if(tiles_dirty || tiles_moving || tiles_camera!=Camera.version){
+			tiles_dirty=0;
+			tiles_camera=Camera.version;
+			tiles_moving=collectTiles(VP,drop);
 		}
+		drawTileBatches(VP);
 	}
-	spo-=2;
-	if(spo<0)
-		spo=0;
-	int l1,r1,l2,r2;
-	l1=(-18+posx1+l3+l6+l7)/6 +4;
-	r1=(-6+posz1+r3+r6+r7+r8+r9)/6+4;
-	l2=(-18+posx2+l3+l6+l7)/6+4;
-	r2=(-6+posz2+r3+r6+r7+r8+r9)/6+4;
-
+	profile_end(PROF_TILES);
+	// The block between the last two steps
+	float lift=prev_spo+(spo-prev_spo)*alpha-(prev_sink+(sink-prev_sink)*alpha);
+	profile_begin(PROF_BLOCK);
 	Matrices.model = glm::mat4(1.0f);
-	glm::mat4 translateTriangle1 = glm::translate (glm::vec3(-18.0f+posx1+l3+l6+l7, 3.0f+posy1+spo, -6.0f+posz1+r3+r4+r6+r7+r8+r9)); // glTranslatef
+	glm::mat4 translateTriangle1 = glm::translate (glm::vec3(cubeX(0), 3.0f+6*sim.height[0]+lift, cubeZ(0))); // glTranslatef
 
 	glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,-3));
 
@@ -2393,12 +1879,10 @@ glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(j+1)*6-30, 0.0f+p
 	Matrices.model *= triangleTransform1; 
 	MVP = VP * Matrices.model; // MVP = p * V * M
 
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	draw3DObject(cub1);
+	drawObject(Meshes.Cube[PAL_BLOCK], MVP);
 
 	Matrices.model = glm::mat4(1.0f);
-	glm::mat4 translateTriangle2 = glm::translate (glm::vec3(-18.0f+posx2+l3+l6+l7, 3.0f+posy2+spo, -6.0f+posz2+r3+r4+r6+r7+r8+r9)); // glTranslatef
+	glm::mat4 translateTriangle2 = glm::translate (glm::vec3(cubeX(1), 3.0f+6*sim.height[1]+lift, cubeZ(1))); // glTranslatef
 
 	glm::mat4 rotateTriangle2 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,-3));
 
@@ -2408,113 +1892,7 @@ glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(j+1)*6-30, 0.0f+p
 	Matrices.model *= triangleTransform2; 
 	MVP = VP * Matrices.model; // MVP = p * V * M
 
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	draw3DObject(cub2);
-	if(a[r1][l1]==0 || a[r2][l2]==0 || r1<0 ||l1<0||r2<0||l2<0){
-	//Matrices.projection = glm::ortho(-100.0f,100.0f,-50.0f,50.0f,0.1f, 500.0f);
-		if(soff==0)
-		system("mpg123  -vC star.mp3 &");
-		double ctime=glfwGetTime();
-		if(ctime-utime>0.05){
-			utime=glfwGetTime();
-			posy1-=2;
-			posy2-=2;
-			disable=1;
-		}
-		if(posy1<-15){
-	view=0;
-		attempts++;
-
-			score-=10;
-			moves-=stmove;
-		init();
-		if(flag==1){
-			level1();
-		}
-		if(flag==2)
-			level2();
-		if(flag==3)
-			level3();
-		if(flag==4)
-			level4();
-		if(flag==5)
-			level6();
-		if(flag==6)
-			level7();
-		if(flag==7)
-			level8();
-		if(flag==8)
-			level9();
-		if(flag==9)
-			utime1=glfwGetTime();
-	}
-
-	}
-	
-	if(a[r1][l1]==4 && a[r2][l2]==4){
-		attempts=1;
-		if(sound==0){
-		if(soff==0)
-
-		system("mpg123  -vC finish.mp3 &");
-		sound=1;
-	}
-		double ctime=glfwGetTime();
-		if(ctime-utime>0.05){
-			utime=glfwGetTime();
-			posy1-=2;
-			posy2-=2;
-		}
-		if(posy1<-20){
-		init();
-		flag++;
-		score+=100;
-		if(flag==2)
-		level2();
-		if(flag==3){
-			level3();
-			l3=0;
-			r3=18;
-		}
-		if(flag==4){
-			level4();	
-		}
-		if(flag==5){
-			level6();
-			l6=-6;
-			r6=-18;
-		}
-		if(flag==6){
-			level7();
-			l7=6;
-			r7=6;
-		}
-		if(flag==7){
-			level8();
-			r8=6;
-		}
-		if(flag==8){
-			level9();
-			r9=-6;
-		}
-		if(flag==1)
-			level1();
-		}
-		if(flag==9)
-			utime1=glfwGetTime();
-	}
-	if(flag==4){
-		for(int i=1;i<3;i++)
-			for(int j=3;j<10;j++)
-				a[i][j]=6;
-			for(int i=6;i<10;i++)
-			for(int j=9;j<15;j++)
-				a[i][j]=6;
-		a[8][13]=5;
-	
-
-	}
+	drawObject(Meshes.Cube[PAL_BLOCK], MVP);
 	Matrices.model = glm::mat4(1.0f);
 
 glm::mat4 translateTriangle11 = glm::translate (glm::vec3(75,-20 ,0 )); // glTranslatef
@@ -2526,9 +1904,7 @@ glm::mat4 translateTriangle11 = glm::translate (glm::vec3(75,-20 ,0 )); // glTra
 				//MVP = VP * Matrices.model; // MVP = p * V * M
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(triangle);
+				drawObject(triangle, MVP);
 
 				Matrices.model = glm::mat4(1.0f);
 
@@ -2541,9 +1917,7 @@ glm::mat4 translateTriangle12 = glm::translate (glm::vec3(85,-30 ,0 )); // glTra
 				//MVP = VP * Matrices.model; // MVP = p * V * M
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(triangle1);
+				drawObject(triangle1, MVP);
 
 				Matrices.model = glm::mat4(1.0f);
 
@@ -2556,9 +1930,7 @@ glm::mat4 translateTriangle13 = glm::translate (glm::vec3(75,-40 ,0 )); // glTra
 				//MVP = VP * Matrices.model; // MVP = p * V * M
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(triangle2);
+				drawObject(triangle2, MVP);
 
 				Matrices.model = glm::mat4(1.0f);
 
@@ -2571,186 +1943,26 @@ glm::mat4 translateTriangle14 = glm::translate (glm::vec3(65,-30 ,0 )); // glTra
 				//MVP = VP * Matrices.model; // MVP = p * V * M
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
 
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(triangle3);
-
-	if(flag==2){
-		Matrices.model = glm::mat4(1.0f);
-
-glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(2+1)*6-30, 0.0f, 0.0f+(4+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle1 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform1 = translateTriangle1 * rotateTriangle1*scaleTriangle1;
-				Matrices.model *= triangleTransform1; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(dcub2);
-
-				Matrices.model = glm::mat4(1.0f);
-
-glm::mat4 translateTriangle2 = glm::translate (glm::vec3(0.0f+(8+1)*6-30, 0.0f, 0.0f+(3+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle2 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle2 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform2 = translateTriangle2 * rotateTriangle2*scaleTriangle2;
-				Matrices.model *= triangleTransform2; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(dcub3);
-
-		if(a[r1][l1]==2 || a[r2][l2]==2){
-		if(a[6][4]==0 && l2tog==0){
-		if(soff==0)
-
-		system("mpg123  -vC star.mp3 &");
-
-			a[6][4]=1;
-			a[6][5]=1;
-			l2f=1;
-		}
-		else if(a[6][4]==1 && l2tog==1){
-		if(soff==0)
-
-		system("mpg123  -vC star.mp3 &");
-
-			a[6][4]=0;
-			a[6][5]=0;
-			l2f=0;
-		}
-		}
-		else if(l2f==1){
-			l2tog=1;
-		}
-		else if(l2f==0){
-			l2tog=0;
-		}
-		if(a[r1][l1]==3 && a[r2][l2]==3){
-		if(a[6][10]==0 && l2togl==0){
-		if(soff==0)
-
-		system("mpg123  -vC star.mp3 &");
-
-			a[6][10]=1;
-			a[6][11]=1;
-			l2r=1;
-		}
-		else if(a[6][10]==1  && l2togl==1){
-		if(soff==0)
-
-		system("mpg123  -vC star.mp3 &");
-
-			a[6][10]=0;
-			a[6][11]=0;
-			l2r=0;
-		}
-		}
-		else if(l2r==1){
-			l2togl=1;
-		}
-		else if(l2r==0){
-			l2togl=0;
-		}
-	}
-	if(flag==4){
-		
-		
-		 if((a[r1][l1]==6 && a[r2][l2]==6 && posy1!=posy2)){
-		a[r1][l1]=0;
-	}
+				drawObject(triangle3, MVP);
 
+	// Switches and teleports, the tile rules themselves run in sim_step()
+	for(int k=0;k<lvl.num_switches;k++){
+		LevelSwitch* sw=&lvl.switches[k];
+		drawMarker(VP, sw->row, sw->col, lvl.tiles[sw->row*lvl.cols+sw->col]==3 ? PAL_SWITCH_HEAVY : PAL_SWITCH);
 	}
-if(flag==6){
-	
-Matrices.model = glm::mat4(1.0f);
-
-glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(9+1)*6-30, 0.0f, 0.0f+(5+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle1 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform1 = translateTriangle1 * rotateTriangle1*scaleTriangle1;
-				Matrices.model *= triangleTransform1; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(dcub);
-				//printf("%d %d\n",a[r1+1][l1+1],a[r2+1][l2+1]);
-		if(a[r1][l1]==2 && a[r2][l2]==2){
-			a[7][3]=1;
-	}
-}
-	if(flag==7){
-		Matrices.model = glm::mat4(1.0f);
-
-glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(4+1)*6-30, 0.0f, 0.0f+(5+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle1 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform1 = translateTriangle1 * rotateTriangle1*scaleTriangle1;
-				Matrices.model *= triangleTransform1; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(dcub1);
-				if(a[r1][l1]==7 && a[r2][l2]==7){
-			posx1+=36;
-			posx2+=36;
-			posy1-=6;
-			posz1+=18;
-			posz2-=18;
-			l8f=1;
-	}
-	if(r1==5 && l1==11 && r2==5 && l2==12)
-		l8f=0;
-	else if(r2==5 && l2==12)
-		l8f=2;
-	}
-
-	if(flag==8){
-		Matrices.model = glm::mat4(1.0f);
-
-glm::mat4 translateTriangle1 = glm::translate (glm::vec3(0.0f+(13+1)*6-30, 0.0f, 0.0f+(4+1)*6-30)); // glTranslatef
-				glm::mat4 rotateTriangle1 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1));
-				glm::mat4 scaleTriangle1 = glm::scale (glm::vec3(1.5f, 0.4f, 1.5f)); // glTranslatef
-				// rotate about vector (1,0,0)
-				glm::mat4 triangleTransform1 = translateTriangle1 * rotateTriangle1*scaleTriangle1;
-				Matrices.model *= triangleTransform1; 
-				MVP = VP * Matrices.model; // MVP = p * V * M
-
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-				draw3DObject(dcub1);
-				if(a[r1][l1]==7 && a[r2][l2]==7){
-			posx1-=6;
-			posx2-=66;
-			posy2-=6;
-			//posz1+=18;
-			//posz2-=18;
-			l8f=1;
-	}
-	if(r1==5 && l1==7 && r2==4 && l2==7)
-		l8f=0;
-	else if(r2==4 && l2==7)
-		l8f=2;
-	}
+	for(int k=0;k<lvl.num_teleports;k++)
+		drawMarker(VP, lvl.teleports[k].row, lvl.teleports[k].col, PAL_TELEPORT);
+	profile_end(PROF_BLOCK);
 
 float fontScaleValue = 10 ;
 static int fontScale=280;
 	glm::vec3 fontColor = getRGBfromHue (fontScale);
 
-	glUseProgram(fontProgramID);
 
 
 	char level_str[30];
 	sprintf(level_str,"MOVES: %d",moves);
-	Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+	Matrices.view = hudView; // Fixed camera for 2D (ortho) in XY plane
 
 	// Transform the text
 	Matrices.model = glm::mat4(1.0f);
@@ -2758,10 +1970,7 @@ static int fontScale=280;
 	glm::mat4 scaleText = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
 	Matrices.model *= (translateText * scaleText);
 	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor[0]);
-	GL3Font.font->Render(level_str);
+	drawText(level_str, MVP, fontColor);
 
 	//display_string(50,35,level_str,fontScaleValue);
 
@@ -2769,6 +1978,15 @@ static int fontScale=280;
 	// Pop matrix to undo transformations till last push matrix instead of recomputing model matrix
 	// glPopMatrix ();
 }
+	if(show_profile)
+		drawProfileHud();
+	profile_begin(PROF_SUBMIT);
+	renderq_flush();
+	profile_end(PROF_SUBMIT);
+	profile_begin(PROF_TEXT);
+	text_flush();
+	glstate_frame();
+	profile_end(PROF_TEXT);
 	// Increment angles
 	float increments = 1;
 
@@ -2777,32 +1995,16 @@ static int fontScale=280;
 	//rectangle_rotation = rectangle_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
 }
 
+int vsync=1; // --no-vsync draws as fast as it can, the game still steps at TICK_HZ
+int headless=0; // --headless <frames> keeps the window hidden and draws offscreen
+
 /* Initialise glfw window, I/O callbacks and the renderer to use */
 /* Nothing to Edit here */
 GLFWwindow* initGLFW (int width, int height)
 {
-	GLFWwindow* window; // window desciptor/handle
-
-	glfwSetErrorCallback(error_callback);
-	if (!glfwInit()) {
-		//        exit(EXIT_FAILURE);
-	}
-
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	window = glfwCreateWindow(width, height, "Sample OpenGL 3.3 Application", NULL, NULL);
-
-	if (!window) {
-		glfwTerminate();
-		//        exit(EXIT_FAILURE);
-	}
-
-	glfwMakeContextCurrent(window);
-	gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
-	glfwSwapInterval( 1 );
+	GLFWwindow* window = openWindow(width, height, "Sample OpenGL 3.3 Application", vsync, !headless);
+	if (!window)
+		exit(EXIT_FAILURE);
 
 	/* --- register callbacks with GLFW --- */
 
@@ -2836,88 +2038,491 @@ void initGL (GLFWwindow* window, int width, int height)
 	createRectangle ();
 	createCuboid();
 	createCircle();
-	// Create and compile our GLSL program from the shaders
-	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
-	// Get a handle for our "MVP" uniform
-	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
-
+	// The scene program and the depth test
+	initScene( "Sample_GL.vert", "Sample_GL.frag" );
+	Tiles.InstancedID = glGetUniformLocation(programID, "instanced");
+	Tiles.ScaleID = glGetUniformLocation(programID, "instanceScale");
+	createButtons();
 
 	reshapeWindow (window, width, height);
 
 	// Background color of the scene
 	glClearColor (1.0f, 1.0f, 1.0f, 0.0f); // R, G, B, A
-	glClearDepth (1.0f);
-
-	glEnable (GL_DEPTH_TEST);
-	glDepthFunc (GL_LEQUAL);
 
 
 
+	// Create and compile our GLSL program from the text shaders, the glyphs are rasterized once into an atlas
+	fontProgramID = LoadShaders( "text.vert", "text.frag" );
 const char* fontfile = "monaco.ttf";
-	GL3Font.font = new FTExtrudeFont(fontfile); // 3D extrude style rendering
-
-	if(GL3Font.font->Error())
+	if(text_init(fontfile, 64, fontProgramID) < 0)
 	{
 		cout << "Error: Could not load font `" << fontfile << "'" << endl;
 		glfwTerminate();
 		exit(EXIT_FAILURE);
 	}
 
-	// Create and compile our GLSL program from the font shaders
-	fontProgramID = LoadShaders( "fontrender.vert", "fontrender.frag" );
-	GLint fontVertexCoordAttrib, fontVertexNormalAttrib, fontVertexOffsetUniform;
-	fontVertexCoordAttrib = glGetAttribLocation(fontProgramID, "vertexPosition");
-	fontVertexNormalAttrib = glGetAttribLocation(fontProgramID, "vertexNormal");
-	fontVertexOffsetUniform = glGetUniformLocation(fontProgramID, "pen");
-	GL3Font.fontMatrixID = glGetUniformLocation(fontProgramID, "MVP");
-	GL3Font.fontColorID = glGetUniformLocation(fontProgramID, "fontColor");
 
-	GL3Font.font->ShaderLocations(fontVertexCoordAttrib, fontVertexNormalAttrib, fontVertexOffsetUniform);
-	GL3Font.font->FaceSize(1);
-	GL3Font.font->Depth(0);
-	GL3Font.font->Outset(0, 0);
-GL3Font.font->CharMap(ft_encoding_unicode);
+	printGLInfo();
+}
+
+/* --watch: the scene shaders and the level files are watched for hot
+   reload. A changed shader pair is compiled on the watch thread in a hidden
+   context that shares objects with the game's, a changed level file is
+   parsed there; the frame loop only swaps the results in between two
+   frames, in hotReload(), and never reads the files itself. */
+GLFWwindow* reload_context;
+int watch_vert=-1, watch_frag=-1, watch_level1=-1; // watch ids, level n is watch_level1+n-1
+
+std::mutex reload_lock;             // guards the results below
+GLuint reload_program=0;            // the newest linked scene program
+std::vector<GLuint> reload_dropped; // programs replaced by a newer one before they were used
+std::vector<Level*> reload_levels;  // parsed level files by number, NULL if unchanged
+std::atomic<int> reload_pending(0); // a result is waiting, checked every frame without the lock
+
+/* Runs on the watch thread */
+void fileChanged (int id)
+{
+	if(id==watch_vert || id==watch_frag){
+		glfwMakeContextCurrent(reload_context);
+		GLuint program=LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
+		GLint linked=GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		glFinish(); // done before the game's context uses it
+		if(!linked){
+			glDeleteProgram(program); // not kept by LoadShaders
+			cout << "Error: Sample_GL.vert/.frag don't link, keeping the old program" << endl;
+			return;
+		}
+		// The game's context may use the one replaced, hotReload() deletes it
+		std::lock_guard<std::mutex> lock(reload_lock);
+		if(reload_program && reload_program!=program)
+			reload_dropped.push_back(reload_program);
+		reload_program=program;
+		reload_pending.store(1);
+		return;
+	}
+	int n=id-watch_level1+1;
+	char path[64];
+	sprintf(path,"levels/level%d.lvl",n);
+	Level* parsed=new Level;
+	if(load_level(path,parsed)<0){
+		cout << "Error: Could not load level `" << path << "', keeping the old one" << endl;
+		delete parsed;
+		return;
+	}
+	std::lock_guard<std::mutex> lock(reload_lock);
+	if(reload_levels.size()<=(size_t)n)
+		reload_levels.resize(n+1,NULL);
+	delete reload_levels[n]; // an older save not played yet
+	reload_levels[n]=parsed;
+	reload_pending.store(1);
+}
+
+void startWatch (GLFWwindow* window)
+{
+	reload_context=openSharedContext(window);
+	if(!reload_context){
+		cout << "Error: No shared context, hot reload is off" << endl;
+		return;
+	}
+	watch_vert=watch_add("Sample_GL.vert");
+	watch_frag=watch_add("Sample_GL.frag");
+	char path[64];
+	for(int n=1;n<=num_levels;n++){
+		sprintf(path,"levels/level%d.lvl",n);
+		int id=watch_add(path);
+		if(n==1)
+			watch_level1=id;
+	}
+	watch_start(fileChanged);
+}
+
+/* Swap in what the watch thread has ready, called between two frames */
+void hotReload ()
+{
+	if(!reload_pending.exchange(0))
+		return;
+	std::vector<GLuint> dropped;
+	std::vector<Level*> levels;
+	GLuint program;
+	{
+		std::lock_guard<std::mutex> lock(reload_lock);
+		program=reload_program;
+		reload_program=0;
+		dropped.swap(reload_dropped);
+		levels.swap(reload_levels);
+	}
+
+	if(program && program!=programID){
+		dropped.push_back(programID);
+		programID=program;
+		Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+		Tiles.InstancedID = glGetUniformLocation(programID, "instanced");
+		Tiles.ScaleID = glGetUniformLocation(programID, "instanceScale");
+		glstate_use_program(programID);
+		cout << "Reloaded Sample_GL.vert/.frag" << endl;
+	}
+	// A program can be dropped more than once, or come back when a save is undone
+	std::sort(dropped.begin(),dropped.end());
+	dropped.erase(std::unique(dropped.begin(),dropped.end()),dropped.end());
+	for(size_t k=0;k<dropped.size();k++)
+		if(dropped[k]!=programID)
+			deleteProgram(dropped[k]);
+
+	// The level being played starts over from the parsed file, the others are read when they are reached
+	for(size_t n=0;n<levels.size();n++){
+		if(!levels[n])
+			continue;
+		if((int)n==flag && blo==1){
+			init(levels[n]);
+			cout << "Reloaded level " << n << endl;
+		}
+		delete levels[n];
+	}
+}
 
+/* A key press of an input script: "<frame> <key>" per line, keys are
+   LEFT RIGHT UP DOWN ENTER SPACE ESCAPE F3 or a single letter or digit */
+struct ScriptKey {
+	int frame;
+	int key;
+};
 
-	cout << "VENDOR: " << glGetString(GL_VENDOR) << endl;
-	cout << "RENDERER: " << glGetString(GL_RENDERER) << endl;
-	cout << "VERSION: " << glGetString(GL_VERSION) << endl;
-	cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
+int keyByName (const char* name)
+{
+	static const struct { const char* name; int key; } keys[] = {
+		{ "LEFT", GLFW_KEY_LEFT }, { "RIGHT", GLFW_KEY_RIGHT }, { "UP", GLFW_KEY_UP }, { "DOWN", GLFW_KEY_DOWN },
+		{ "ENTER", GLFW_KEY_ENTER }, { "SPACE", GLFW_KEY_SPACE }, { "ESCAPE", GLFW_KEY_ESCAPE }, { "F3", GLFW_KEY_F3 }
+	};
+	for (int i=0; i<(int)(sizeof(keys)/sizeof(keys[0])); i++)
+		if (!strcmp(name, keys[i].name))
+			return keys[i].key;
+	// GLFW's letter and digit keys are their ASCII codes
+	if (name[0] && !name[1] && isalnum((unsigned char)name[0]))
+		return toupper((unsigned char)name[0]);
+	return -1;
 }
 
+int loadScript (const char* path, std::vector<ScriptKey>* script)
+{
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		cout << "Error: Could not open input script `" << path << "'" << endl;
+		return -1;
+	}
+	char line[128], name[32];
+	int n = 0;
+	while (fgets(line, sizeof(line), f)) {
+		n++;
+		ScriptKey k;
+		if (line[0] == '#' || sscanf(line, "%d %31s", &k.frame, name) < 1)
+			continue;
+		k.key = keyByName(name);
+		if (k.key < 0) {
+			cout << "Error: " << path << ":" << n << ": unknown key `" << name << "'" << endl;
+			fclose(f);
+			return -1;
+		}
+		script->push_back(k);
+	}
+	fclose(f);
+	return 0;
+}
+
+/* Close a frame's counters, shared by the window, headless and replay loops.
+   The live GL objects are back to the same counts on a level played again
+   unless they leak. */
+void endFrame ()
+{
+	trace_counter(TRACE_GL_OBJECTS, gl_buffers_alive, gl_vertex_arrays_alive);
+	profile_frame();
+}
+
+/* Draw the given number of frames offscreen, one game step per frame and the
+   game clock stepped with them, so a run gives the same images every time */
+void runHeadless (GLFWwindow* window, int frames, const std::vector<ScriptKey>& script)
+{
+	size_t next = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	glfwSetTime(0);
+	for (int f=0; f<frames; f++) {
+		trace_begin(TRACE_FRAME);
+		profile_begin(PROF_INPUT);
+		for (; next<script.size() && script[next].frame<=f; next++) {
+			keyboard(window, script[next].key, 0, GLFW_PRESS, 0);
+			keyboard(window, script[next].key, 0, GLFW_RELEASE, 0);
+		}
+		profile_end(PROF_INPUT);
+
+		glfwSetTime((f+1)*TICK);
+		profile_begin(PROF_SIM);
+		update();
+		profile_end(PROF_SIM);
+
+		trace_begin(TRACE_DRAW);
+		capture_begin();
+		draw(0);
+		capture_end(f);
+		trace_end(TRACE_DRAW);
+
+		glfwPollEvents();
+		trace_end(TRACE_FRAME);
+		endFrame();
+	}
+	capture_finish();
+	glFinish();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("headless: %d frames in %.3f s, %.3f ms/frame\n", frames, seconds, frames ? 1000*seconds/frames : 0);
+}
+
+/* Hand one logged event to the callback that got it */
+void replayEvent (GLFWwindow* window, const InputEvent& e)
+{
+	switch (e.type) {
+		case INPUT_KEY:
+			keyboard(window, e.code, 0, e.action, 0);
+			break;
+		case INPUT_BUTTON:
+			replay_x = e.x;
+			replay_y = e.y;
+			mouseButton(window, e.code, e.action, 0);
+			break;
+		case INPUT_SCROLL:
+			mousezoom(window, e.x, e.y);
+			break;
+		case INPUT_CURSOR:
+			replay_x = e.x;
+			replay_y = e.y;
+			break;
+		case INPUT_DRAG:
+			drag(window);
+			break;
+	}
+}
+
+/* Play an input log back, one game step per frame with the game clock stepped
+   along, so the run ends in the state the recording did. With benchmark the
+   frames are timed and the frame rate and final game state are printed. */
+void runReplay (GLFWwindow* window, const std::vector<InputEvent>& events, int benchmark)
+{
+	// Live input would change the game under the log
+	glfwSetKeyCallback(window, NULL);
+	glfwSetCharCallback(window, NULL);
+	glfwSetMouseButtonCallback(window, NULL);
+	glfwSetScrollCallback(window, NULL);
+	replaying = 1;
+
+	std::vector<double> frame_ms;
+	size_t next = 0;
+	int done = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	glfwSetTime(0);
+	while (!glfwWindowShouldClose(window)) {
+		std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+		trace_begin(TRACE_FRAME);
+		profile_begin(PROF_INPUT);
+		for (; events[next].tick<=game_ticks; next++) {
+			// Escape closed the window when it was recorded
+			if (events[next].type == INPUT_END || (events[next].type == INPUT_KEY && events[next].code == GLFW_KEY_ESCAPE)) {
+				done = 1;
+				break;
+			}
+			replayEvent(window, events[next]);
+		}
+		profile_end(PROF_INPUT);
+		if (done)
+			break;
+
+		glfwSetTime((game_ticks+1)*TICK);
+		profile_begin(PROF_SIM);
+		update();
+		profile_end(PROF_SIM);
+
+		trace_begin(TRACE_DRAW);
+		draw(0);
+		trace_end(TRACE_DRAW);
+
+		trace_begin(TRACE_SWAP);
+		profile_begin(PROF_SWAP);
+		glfwSwapBuffers(window);
+		profile_end(PROF_SWAP);
+		trace_end(TRACE_SWAP);
+		glfwPollEvents();
+		trace_end(TRACE_FRAME);
+		endFrame();
+		frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+	}
+	if (!benchmark)
+		return;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	int frames = frame_ms.size();
+	std::sort(frame_ms.begin(), frame_ms.end());
+	double p[4] = { 0.5, 0.9, 0.99, 1 };
+	printf("replay: %d frames in %.3f s, %.1f fps\n", frames, seconds, seconds > 0 ? frames/seconds : 0);
+	if (frames)
+		printf("frame ms: p50 %.3f p90 %.3f p99 %.3f max %.3f\n", frame_ms[std::min(frames-1, (int)(p[0]*frames))],
+			frame_ms[std::min(frames-1, (int)(p[1]*frames))], frame_ms[std::min(frames-1, (int)(p[2]*frames))], frame_ms[frames-1]);
+	printf("final: score %d moves %d flag %d\n", score, moves, flag);
+}
+
+#ifndef SAMPLE2D_NO_MAIN // bench.cpp includes the game without its main()
 int main (int argc, char** argv)
 {
 	int width = 1500;
 	int height = 800;
 
+	// --audio-null plays nothing, --audio-file <path> writes the mixed sound to a raw file,
+	// --trace <path> records a trace for trace2json, --profile <csv> writes every frame's phase times at exit,
+	// --no-vsync unlocks the frame rate for throughput runs, --level <n> starts playing level n.
+	// --headless <frames> draws that many frames offscreen and exits; with it --input <script>
+	// presses keys on given frames and --dump <dir> writes every frame there (--raw: as raw RGBA, else PNG).
+	// --record <file> logs the input of a game, --replay <file> plays it back, one step per frame;
+	// with --benchmark as fast as it can, then prints the frame times and the final score.
+	// --watch reloads the scene shaders and the level being played when their files change.
+	int sink = AUDIO_DEVICE;
+	const char* sink_path = NULL;
+	const char* profile_path = NULL;
+	const char* script_path = NULL;
+	const char* dump_dir = NULL;
+	int dump_format = CAPTURE_PNG;
+	int start_level = 0;
+	const char* record_path = NULL;
+	const char* replay_path = NULL;
+	int benchmark = 0;
+	int watch = 0;
+	for (int i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "--audio-null"))
+			sink = AUDIO_NULL;
+		else if (!strcmp(argv[i], "--audio-file") && i+1<argc) {
+			sink = AUDIO_FILE;
+			sink_path = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--trace") && i+1<argc)
+			trace_start(argv[++i]);
+		else if (!strcmp(argv[i], "--profile") && i+1<argc)
+			profile_path = argv[++i];
+		else if (!strcmp(argv[i], "--no-vsync"))
+			vsync = 0;
+		else if (!strcmp(argv[i], "--level") && i+1<argc)
+			start_level = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--headless") && i+1<argc)
+			headless = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--input") && i+1<argc)
+			script_path = argv[++i];
+		else if (!strcmp(argv[i], "--dump") && i+1<argc)
+			dump_dir = argv[++i];
+		else if (!strcmp(argv[i], "--raw"))
+			dump_format = CAPTURE_RAW;
+		else if (!strcmp(argv[i], "--record") && i+1<argc)
+			record_path = argv[++i];
+		else if (!strcmp(argv[i], "--replay") && i+1<argc)
+			replay_path = argv[++i];
+		else if (!strcmp(argv[i], "--benchmark"))
+			benchmark = 1;
+		else if (!strcmp(argv[i], "--watch"))
+			watch = 1;
+	}
+	std::vector<ScriptKey> script;
+	if (script_path && loadScript(script_path, &script) < 0)
+		return 1;
+	std::vector<InputEvent> events;
+	if (replay_path && replay_load(replay_path, &events) < 0)
+		return 1;
+	if (record_path && replay_record_start(record_path) < 0)
+		return 1;
+	if (benchmark)
+		vsync = 0;
+	audio_init((headless || benchmark) && sink==AUDIO_DEVICE ? AUDIO_NULL : sink, sink_path);
+
 	GLFWwindow* window = initGLFW(width, height);
 
+	num_levels = countLevels();
 	initGL (window, width, height);
+	profile_init(profile_path);
+	if (start_level >= 1 && start_level <= num_levels) {
+		flag = start_level;
+		blo = 1;
+		init();
+		start_ticks = game_ticks;
+	}
+
+	if (headless) {
+		if (capture_init(width, height, dump_dir ? dump_format : CAPTURE_NONE, dump_dir) < 0)
+			return 1;
+		runHeadless(window, headless, script);
+		replay_record_stop(game_ticks);
+		trace_stop();
+		audio_shutdown();
+		glfwTerminate();
+		return 0;
+	}
+
+	if (replay_path) {
+		runReplay(window, events, benchmark);
+		replay_record_stop(game_ticks);
+		trace_stop();
+		audio_shutdown();
+		glfwTerminate();
+		return 0;
+	}
+
+	if (watch)
+		startWatch(window);
 
 	double last_update_time = glfwGetTime();
+	Timestep step;
+	timestep_start(&step, glfwGetTime());
 
 	/* Draw in loop */
 	while (!glfwWindowShouldClose(window)) {
+		trace_begin(TRACE_FRAME);
+
+		// Advance the game in fixed steps, then draw between the last two
+		profile_begin(PROF_SIM);
+		for (int n = timestep_advance(&step, glfwGetTime()); n > 0; n--)
+			update();
+		profile_end(PROF_SIM);
 
 		// OpenGL Draw commands
-		draw();
+		trace_begin(TRACE_DRAW);
+		draw(timestep_alpha(&step));
+		trace_end(TRACE_DRAW);
 
 		// Swap Frame Buffer in double buffering
+		trace_begin(TRACE_SWAP);
+		profile_begin(PROF_SWAP);
 		glfwSwapBuffers(window);
- display_string(window);
+		profile_end(PROF_SWAP);
+		trace_end(TRACE_SWAP);
 
 		// Poll for Keyboard and mouse events
+		trace_begin(TRACE_EVENTS);
+		profile_begin(PROF_INPUT);
 		glfwPollEvents();
-		if(heli==1  && lmouse1==1)
+		if(view!=0 && lmouse1==1){
 			drag(window);
+			replay_record(game_ticks, INPUT_DRAG, 0, 0, 0, 0);
+		}
+		profile_end(PROF_INPUT);
+		trace_end(TRACE_EVENTS);
 		// Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
 		current_time = glfwGetTime(); // Time in seconds
 		if ((current_time - last_update_time) >= 0.5) { // atleast 0.5s elapsed since last frame
 			// do something every 0.5 seconds ..
 			last_update_time = current_time;
 		}
+		trace_end(TRACE_FRAME);
+		endFrame();
+		if (watch)
+			hotReload();
 	}
 
+	replay_record_stop(game_ticks);
+	watch_stop();
+	trace_stop();
+	audio_shutdown();
 	glfwTerminate();
 	//    exit(EXIT_SUCCESS);
 }
+#endif
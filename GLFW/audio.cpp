@@ -0,0 +1,190 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mpg123.h>
+#include <out123.h>
+#include "audio.h"
+
+#define AUDIO_RATE 44100
+#define AUDIO_CHANNELS 2
+#define AUDIO_BLOCK 512  // frames mixed per pass, about 12 ms
+#define AUDIO_VOICES 16  // sounds playing at once, more are dropped
+#define AUDIO_QUEUE 64   // pending play commands, a power of two
+
+static const char* sound_files[SOUND_COUNT] = { "sound1.mp3", "star.mp3", "finish.mp3" };
+
+struct Voice {
+	int sound;
+	size_t pos; // next sample in the sound's pcm
+};
+
+struct AudioMixer {
+	std::vector<short> pcm[SOUND_COUNT]; // interleaved stereo, empty if the file is missing
+	int sink;
+	out123_handle* device;
+	FILE* file;
+	std::thread thread;
+	std::atomic<bool> running;
+
+	// Written only by the game thread (head) and the mixer (tail)
+	int queue[AUDIO_QUEUE];
+	std::atomic<unsigned> head;
+	std::atomic<unsigned> tail;
+} Mixer;
+
+static int decode_sound (const char* path, std::vector<short>* pcm)
+{
+	int err;
+	mpg123_handle* mh = mpg123_new(NULL, &err);
+	if (!mh)
+		return -1;
+	// Every sound comes out in the mixer's format, mpg123 resamples if it has to
+	mpg123_format_none(mh);
+	mpg123_format(mh, AUDIO_RATE, MPG123_STEREO, MPG123_ENC_SIGNED_16);
+	if (mpg123_open(mh, path) != MPG123_OK) {
+		fprintf(stderr, "Error: Could not open sound `%s'\n", path);
+		mpg123_delete(mh);
+		return -1;
+	}
+
+	short buffer[4096];
+	size_t done;
+	int ret;
+	do {
+		ret = mpg123_read(mh, (unsigned char*)buffer, sizeof(buffer), &done);
+		pcm->insert(pcm->end(), buffer, buffer + done/sizeof(short));
+	} while (ret == MPG123_OK || ret == MPG123_NEW_FORMAT);
+
+	mpg123_close(mh);
+	mpg123_delete(mh);
+	return ret == MPG123_DONE ? 0 : -1;
+}
+
+static void write_block (short* samples, int count)
+{
+	if (Mixer.sink == AUDIO_DEVICE) {
+		// The device blocks until it has room, which paces the mixer
+		out123_play(Mixer.device, samples, count*sizeof(short));
+		return;
+	}
+	if (Mixer.sink == AUDIO_FILE)
+		fwrite(samples, sizeof(short), count, Mixer.file);
+	std::this_thread::sleep_for(std::chrono::microseconds(1000000LL*AUDIO_BLOCK/AUDIO_RATE));
+}
+
+static void mix_loop ()
+{
+	Voice voices[AUDIO_VOICES];
+	int active = 0;
+	int mix[AUDIO_BLOCK*AUDIO_CHANNELS];
+	short out[AUDIO_BLOCK*AUDIO_CHANNELS];
+
+	while (Mixer.running.load(std::memory_order_acquire)) {
+		unsigned tail = Mixer.tail.load(std::memory_order_relaxed);
+		unsigned head = Mixer.head.load(std::memory_order_acquire);
+		for (; tail != head; tail++) {
+			int sound = Mixer.queue[tail & (AUDIO_QUEUE-1)];
+			if (active < AUDIO_VOICES && !Mixer.pcm[sound].empty()) {
+				voices[active].sound = sound;
+				voices[active].pos = 0;
+				active++;
+			}
+		}
+		Mixer.tail.store(tail, std::memory_order_release);
+
+		memset(mix, 0, sizeof(mix));
+		for (int v=0; v<active; ) {
+			const std::vector<short>& pcm = Mixer.pcm[voices[v].sound];
+			size_t count = pcm.size() - voices[v].pos;
+			if (count > AUDIO_BLOCK*AUDIO_CHANNELS)
+				count = AUDIO_BLOCK*AUDIO_CHANNELS;
+			const short* src = &pcm[voices[v].pos];
+			for (size_t i=0; i<count; i++)
+				mix[i] += src[i];
+			voices[v].pos += count;
+			if (voices[v].pos == pcm.size())
+				voices[v] = voices[--active];
+			else
+				v++;
+		}
+
+		for (int i=0; i<AUDIO_BLOCK*AUDIO_CHANNELS; i++)
+			out[i] = mix[i] > 32767 ? 32767 : mix[i] < -32768 ? -32768 : mix[i];
+		write_block(out, AUDIO_BLOCK*AUDIO_CHANNELS);
+	}
+}
+
+/* Decode the sounds and start the mixer. Without a sound device the mixer
+   runs on the null sink, so the game always has sound calls to make. */
+int audio_init (int sink, const char* path)
+{
+	mpg123_init();
+	for (int s=0; s<SOUND_COUNT; s++)
+		if (decode_sound(sound_files[s], &Mixer.pcm[s]) < 0)
+			Mixer.pcm[s].clear();
+
+	Mixer.device = NULL;
+	Mixer.file = NULL;
+	if (sink == AUDIO_DEVICE) {
+		Mixer.device = out123_new();
+		if (!Mixer.device || out123_open(Mixer.device, NULL, NULL) != 0
+			|| out123_start(Mixer.device, AUDIO_RATE, AUDIO_CHANNELS, MPG123_ENC_SIGNED_16) != 0) {
+			fprintf(stderr, "Error: Could not open the sound device, sound is off\n");
+			if (Mixer.device)
+				out123_del(Mixer.device);
+			Mixer.device = NULL;
+			sink = AUDIO_NULL;
+		}
+	}
+	else if (sink == AUDIO_FILE) {
+		Mixer.file = fopen(path, "wb");
+		if (!Mixer.file) {
+			fprintf(stderr, "Error: Could not open `%s' for writing, sound is off\n", path);
+			sink = AUDIO_NULL;
+		}
+	}
+
+	Mixer.sink = sink;
+	Mixer.head.store(0);
+	Mixer.tail.store(0);
+	Mixer.running.store(true);
+	Mixer.thread = std::thread(mix_loop);
+	// A joinable thread must not outlive main(), whichever way the game exits
+	atexit(audio_shutdown);
+	return 0;
+}
+
+void audio_play (int sound)
+{
+	if (!Mixer.running.load(std::memory_order_relaxed))
+		return;
+	unsigned head = Mixer.head.load(std::memory_order_relaxed);
+	if (head - Mixer.tail.load(std::memory_order_acquire) == AUDIO_QUEUE)
+		return; // the mixer is behind, drop the sound rather than wait
+	Mixer.queue[head & (AUDIO_QUEUE-1)] = sound;
+	Mixer.head.store(head + 1, std::memory_order_release);
+}
+
+void audio_shutdown ()
+{
+	if (!Mixer.running.load())
+		return;
+	Mixer.running.store(false, std::memory_order_release);
+	Mixer.thread.join();
+
+	if (Mixer.device) {
+		out123_stop(Mixer.device);
+		out123_close(Mixer.device);
+		out123_del(Mixer.device);
+		Mixer.device = NULL;
+	}
+	if (Mixer.file) {
+		fclose(Mixer.file);
+		Mixer.file = NULL;
+	}
+	mpg123_exit();
+}
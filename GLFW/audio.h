@@ -0,0 +1,21 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+/*
+ * Sound effects. Every sound is decoded once by audio_init() and mixed on
+ * a thread of its own; audio_play() only puts a command on a lock-free
+ * queue, so it never blocks the input callbacks or the frame.
+ *
+ * The mixer writes to the sound device, to nothing (AUDIO_NULL) or to a
+ * raw file of 16 bit stereo samples at 44100 Hz (AUDIO_FILE), the last two
+ * for running without a sound card.
+ */
+
+enum AudioSound { SOUND_ROLL, SOUND_STAR, SOUND_FINISH, SOUND_COUNT };
+enum AudioSink { AUDIO_DEVICE, AUDIO_NULL, AUDIO_FILE };
+
+int audio_init (int sink, const char* path);
+void audio_play (int sound);
+void audio_shutdown ();
+
+#endif
@@ -0,0 +1,273 @@
+/*
+ * Microbenchmarks of the game's hot helpers and of whole frames.
+ *
+ *   ./bench [--json <file>] [--filter <text>] [--hw]
+ *
+ * The game is built in with Sample_GL3_2D.cpp's main() left out. Each
+ * benchmark body runs in batches that grow until a batch takes at least
+ * BENCH_MIN_TIME; the time per iteration of that batch is reported. Results
+ * are printed and written to bench.json in Google Benchmark's JSON format,
+ * so its compare.py can diff two runs.
+ *
+ * Before timing anything it checks that an input log replays a menu click
+ * as it was recorded, and that playing the levels again leaks no GL
+ * objects; either failing exits with 1.
+ *
+ * GL runs in a hidden window on Mesa's software rasterizer unless --hw is
+ * given, so the numbers don't depend on the machine's GPU. Run it from the
+ * GLFW directory, it needs the shaders, the font and the levels.
+ */
+#define SAMPLE2D_NO_MAIN
+#include "Sample_GL3_2D.cpp"
+
+#include <ctime>
+#include <string>
+
+#define BENCH_MIN_TIME 0.5 // s
+
+struct BenchResult {
+	std::string name;
+	long iterations;
+	double real_ns, cpu_ns; // per iteration
+	int frame;              // a draw() benchmark, gl has one frame's state calls
+	GLStateCounts gl;
+	int tiles;              // tiles drawn after culling
+};
+
+std::vector<BenchResult> results;
+const char* bench_filter = NULL;
+volatile float bench_sink; // results are stored here so the compiler keeps the work
+
+/* Run body() until a batch is long enough to time. With gl, every batch ends
+   with glFinish() so the GPU work is counted too. */
+template <class F>
+void bench (const std::string& name, F body, int gl=0)
+{
+	if (bench_filter && name.find(bench_filter) == std::string::npos)
+		return;
+	body(); // warm up
+	for (long n=1; ; ) {
+		std::clock_t cpu_start = std::clock();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (long i=0; i<n; i++)
+			body();
+		if (gl)
+			glFinish();
+		double real = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double cpu = (double)(std::clock() - cpu_start)/CLOCKS_PER_SEC;
+		if (real >= BENCH_MIN_TIME || n >= 1000000000L) {
+			BenchResult r = BenchResult();
+			r.name = name;
+			r.iterations = n;
+			r.real_ns = 1e9*real/n;
+			r.cpu_ns = 1e9*cpu/n;
+			results.push_back(r);
+			printf("%-32s %12.0f ns %12.0f ns %12ld\n", name.c_str(), r.real_ns, r.cpu_ns, n);
+			fflush(stdout);
+			return;
+		}
+		// Aim a little past the minimum so the next batch is usually the last
+		long next = real > 0 ? (long)(n*BENCH_MIN_TIME*1.4/real) : n*10;
+		n = std::max(n+1, std::min(next, n*100));
+	}
+}
+
+int writeJson (const char* path)
+{
+	FILE* f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "Error: Could not write `%s'\n", path);
+		return -1;
+	}
+	char date[64];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	fprintf(f, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"executable\": \"bench\",\n", date);
+	fprintf(f, "    \"renderer\": \"%s\",\n    \"num_cpus\": %ld,\n    \"library_build_type\": \"release\"\n  },\n", (const char*)glGetString(GL_RENDERER), sysconf(_SC_NPROCESSORS_ONLN));
+	fprintf(f, "  \"benchmarks\": [\n");
+	for (size_t i=0; i<results.size(); i++) {
+		const BenchResult& r = results[i];
+		fprintf(f, "    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n", r.name.c_str(), r.name.c_str());
+		fprintf(f, "      \"iterations\": %ld,\n      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n      \"time_unit\": \"ns\"",
+			r.iterations, r.real_ns, r.cpu_ns);
+		// GL state calls and tiles drawn of a frame, as user counters
+		if (r.frame)
+			fprintf(f, ",\n      \"tiles_visible\": %d", r.tiles);
+		for (int k=0; r.frame && k<GLS_KINDS; k++)
+			fprintf(f, ",\n      \"gl_%s\": %d,\n      \"gl_%s_skipped\": %d", glstate_names[k], r.gl.changes[k], glstate_names[k], r.gl.skipped[k]);
+		fprintf(f, "\n    }%s\n", i+1 < results.size() ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+	fclose(f);
+	return 0;
+}
+
+/* Record a click on the title screen's enter button and replay it, the
+   replayed click has to start the game the same way. A hidden window has no
+   cursor, so it is pinned through the replay cursor while recording. */
+int checkReplay (GLFWwindow* window)
+{
+	const char* path = "bench.input";
+	int w, h;
+	glfwGetWindowSize(window, &w, &h);
+	if (replay_record_start(path) < 0)
+		return -1;
+	replaying = 1;
+	replay_x = 726.0*w/1500;
+	replay_y = 462.0*h/800;
+	mouseButton(window, GLFW_MOUSE_BUTTON_LEFT, GLFW_PRESS, 0);
+	mouseButton(window, GLFW_MOUSE_BUTTON_LEFT, GLFW_RELEASE, 0);
+	replay_record_stop(game_ticks);
+	int recorded = enter;
+
+	std::vector<InputEvent> events;
+	int loaded = replay_load(path, &events);
+	remove(path);
+	enter = 0;
+	replay_x = replay_y = 0;
+	for (size_t i=0; loaded == 0 && i<events.size(); i++)
+		replayEvent(window, events[i]);
+	replaying = 0;
+	int replayed = enter;
+	enter = 0;
+	if (!recorded || !replayed) {
+		fprintf(stderr, "Error: a replayed click on the title screen %s\n", recorded ? "missed it" : "was not recorded");
+		return -1;
+	}
+	return 0;
+}
+
+/* Start level n with the intro screen over and every tile in place */
+void playLevel (int n)
+{
+	flag = n;
+	blo = 1;
+	attempts = 1;
+	view = 0;
+	init();
+	dis = 0;
+	spo = prev_spo = 0;
+	level_ticks = 1000;
+	start_ticks = game_ticks;
+}
+
+/* Play and draw every level twice, the GL objects alive after the second
+   pass have to be no more than after the first */
+int checkLeaks ()
+{
+	int buffers=0, arrays=0;
+	for (int pass=0; pass<2; pass++) {
+		for (int n=1; n<=num_levels; n++) {
+			playLevel(n);
+			draw(0);
+		}
+		if (pass == 0) {
+			buffers = gl_buffers_alive;
+			arrays = gl_vertex_arrays_alive;
+		}
+	}
+	if (gl_buffers_alive > buffers || gl_vertex_arrays_alive > arrays) {
+		fprintf(stderr, "Error: GL objects leak, playing the levels again took buffers %d -> %d, vertex arrays %d -> %d\n",
+			buffers, gl_buffers_alive, arrays, gl_vertex_arrays_alive);
+		return -1;
+	}
+	return 0;
+}
+
+int main (int argc, char** argv)
+{
+	const char* json_path = "bench.json";
+	int hw = 0;
+	for (int i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "--json") && i+1<argc)
+			json_path = argv[++i];
+		else if (!strcmp(argv[i], "--filter") && i+1<argc)
+			bench_filter = argv[++i];
+		else if (!strcmp(argv[i], "--hw"))
+			hw = 1;
+	}
+	if (!hw)
+		setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+
+	int width = 1500;
+	int height = 800;
+	headless = 1;
+	vsync = 0;
+	soff = 1;
+	audio_init(AUDIO_NULL, NULL);
+	GLFWwindow* window = initGLFW(width, height);
+	num_levels = countLevels();
+	initGL(window, width, height);
+	profile_init(NULL);
+	if (checkReplay(window) < 0 || checkLeaks() < 0) {
+		audio_shutdown();
+		glfwTerminate();
+		return 1;
+	}
+	printf("%-32s %15s %15s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+
+	// A cube's 36 vertices, as createCuboid uploads them
+	GLfloat cube[36*3], colors[36*3];
+	for (int i=0; i<36*3; i++) {
+		cube[i] = (i*7 % 5) - 2.0f;
+		colors[i] = (i % 3)/2.0f;
+	}
+	bench("BM_create3DObject/colors", [&]() {
+		deleteObject(create3DObject(GL_TRIANGLES, 36, cube, colors));
+	}, 1);
+	bench("BM_create3DObject/common_color", [&]() {
+		deleteObject(create3DObject(GL_TRIANGLES, 36, cube, 1.0f, 0.5f, 0.0f));
+	}, 1);
+
+	glstate_use_program(programID);
+	glm::mat4 MVP = glm::ortho(-100.0f, 100.0f, -50.0f, 50.0f, 0.1f, 500.0f)*hudView;
+	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+	bench("BM_draw3DObject/cube", [&]() {
+		draw3DObject(Meshes.Cube[PAL_BLOCK]);
+	}, 1);
+
+	int hue = 0;
+	bench("BM_getRGBfromHue", [&]() {
+		bench_sink = getRGBfromHue(hue).x;
+		hue = (hue + 7) % 360;
+	});
+
+	// Roll right and back, the level starts over if the block falls or wins
+	playLevel(1);
+	SimState start = sim;
+	int key = 0;
+	bench("BM_keyboard/move", [&]() {
+		keyboard(window, key ? GLFW_KEY_LEFT : GLFW_KEY_RIGHT, 0, GLFW_PRESS, 0);
+		key = !key;
+		if (sim.status != SIM_PLAYING)
+			sim = start;
+	});
+
+	for (int n=1; n<=num_levels; n++) {
+		char name[64];
+		playLevel(n);
+		updateCamera();
+		glm::mat4 VP = Camera.VP;
+		// Halfway through the drop, about half the tiles have landed, so the fall check takes both branches
+		sprintf(name, "BM_collectTiles/level%d", n);
+		bench(name, [&]() {
+			bench_sink = collectTiles(VP, 2*-BOARD_DROP_HEIGHT/(float)(board.rows + board.cols));
+		});
+		sprintf(name, "BM_draw/level%d", n);
+		bench(name, [&]() {
+			draw(0);
+			glFinish();
+		});
+		if (!results.empty() && results.back().name == name) {
+			draw(0);
+			results.back().frame = 1;
+			results.back().gl = glstate.last;
+			results.back().tiles = tiles_visible;
+		}
+	}
+
+	int status = writeJson(json_path) < 0;
+	audio_shutdown();
+	glfwTerminate();
+	return status;
+}
@@ -2,6 +2,8 @@
 #include <cmath>
 #include <fstream>
 #include <vector>
+#include <cstring>
+#include <cstddef>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -11,25 +13,16 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <FTGL/ftgl.h>
+
+#include "audio.h"
+#include "trace.h"
+#include "timestep.h"
+#include "glstate.h"
+#include "renderq.h"
+#include "cull.h"
+#include "engine.h"
 using namespace std;
 
-struct VAO {
-	GLuint VertexArrayID;
-	GLuint VertexBuffer;
-	GLuint ColorBuffer;
-
-	GLenum PrimitiveMode;
-	GLenum FillMode;
-	int NumVertices;
-};
-typedef struct VAO VAO;
-
-struct GLMatrices {
-	glm::mat4 projection;
-	glm::mat4 model;
-	glm::mat4 view;
-	GLuint MatrixID;
-} Matrices;
 struct FTGLFont {
 	FTFont* font;
 	GLuint fontMatrixID;
@@ -37,89 +30,7 @@ struct FTGLFont {
 } GL3Font;
 
 
-GLuint programID,fontProgramID, textureProgramID;
-
-/* Function to load Shaders - Use it as it is */
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
-
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open())
-	{
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
-	}
-
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
-	}
-
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
-
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
-
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> VertexShaderErrorMessage(InfoLogLength);
-	glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-	fprintf(stdout, "%s\n", &VertexShaderErrorMessage[0]);
-
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
-
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> FragmentShaderErrorMessage(InfoLogLength);
-	glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-	fprintf(stdout, "%s\n", &FragmentShaderErrorMessage[0]);
-
-	// Link the program
-	fprintf(stdout, "Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
-
-	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> ProgramErrorMessage( max(InfoLogLength, int(1)) );
-	glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-	fprintf(stdout, "%s\n", &ProgramErrorMessage[0]);
-
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
-
-	return ProgramID;
-}
-
-static void error_callback(int error, const char* description)
-{
-	fprintf(stderr, "Error: %s\n", description);
-}
+GLuint fontProgramID, textureProgramID;
 
 void quit(GLFWwindow *window)
 {
@@ -127,109 +38,6 @@ void quit(GLFWwindow *window)
 	glfwTerminate();
 	//    exit(EXIT_SUCCESS);
 }
-glm::vec3 getRGBfromHue (int hue)
-{
-	float intp;
-	float fracp = modff(hue/60.0, &intp);
-	float x = 1.0 - abs((float)((int)intp%2)+fracp-1.0);
-	float y=1;
-	if(hue==100){
-		return glm::vec3(1,1,1);
-
-	}
-	else{
-		if (hue < 60)
-			return glm::vec3(1,x,0);
-		else if (hue < 120)
-			return glm::vec3(x,1,0);
-		else if (hue < 180)
-			return glm::vec3(0,1,x);
-		else if (hue < 240)
-			return glm::vec3(0,x,1);
-		else if (hue < 300)
-			return glm::vec3(x,0,1);
-		else
-			return glm::vec3(1,0,x);
-
-	}
-}
-
-
-/* Generate VAO, VBOs and return VAO handle */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
-{
-	struct VAO* vao = new struct VAO;
-	vao->PrimitiveMode = primitive_mode;
-	vao->NumVertices = numVertices;
-	vao->FillMode = fill_mode;
-
-	// Create Vertex Array Object
-	// Should be done after CreateWindow and before any other GL calls
-	glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
-	glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
-	glGenBuffers (1, &(vao->ColorBuffer));  // VBO - colors
-
-	glBindVertexArray (vao->VertexArrayID); // Bind the VAO 
-	glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices 
-	glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW); // Copy the vertices into VBO
-	glVertexAttribPointer(
-			0,                  // attribute 0. Vertices
-			3,                  // size (x,y,z)
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-			);
-
-	glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors 
-	glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
-	glVertexAttribPointer(
-			1,                  // attribute 1. Color
-			3,                  // size (r,g,b)
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-			);
-
-	return vao;
-}
-
-/* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
-{
-	GLfloat* color_buffer_data = new GLfloat [3*numVertices];
-	for (int i=0; i<numVertices; i++) {
-		color_buffer_data [3*i] = red;
-		color_buffer_data [3*i + 1] = green;
-		color_buffer_data [3*i + 2] = blue;
-	}
-
-	return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
-}
-
-/* Render the VBOs handled by VAO */
-void draw3DObject (struct VAO* vao)
-{
-	// Change the Fill Mode for this object
-	glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
-
-	// Bind the VAO to use
-	glBindVertexArray (vao->VertexArrayID);
-
-	// Enable Vertex Attribute 0 - 3d Vertices
-	glEnableVertexAttribArray(0);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
-
-	// Enable Vertex Attribute 1 - Color
-	glEnableVertexAttribArray(1);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
-
-	// Draw the geometry !
-	glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
-}
 int heli=0,lmouse1=0,mouse=0,blo=0;
 float lx1,zoom=1,camera_rotation_angle1,camera_rotation_angle;
 double lxg,lyg;
@@ -278,11 +86,9 @@ void drag (GLFWwindow* window){
 	double ly1;
 	glfwGetCursorPos(window, &lx1, &ly1);
 	//printf("%f %f\n",lx1,lxg);
-		cout<<"hhk";
 	if(heli==1 && mouse==1){
-		cout<<"hhk";
-		camera_rotation_angle-=(lx1-lxg)/800;
-		camera_rotation_angle1-=(lx1-lxg)/800;
+		camera_rotation_angle+=dragAngle(lx1,lxg);
+		camera_rotation_angle1+=dragAngle(lx1,lxg);
 	}
 }
 int moves=0;
@@ -294,12 +100,21 @@ int count=0;
 /*int heli=0,lmouse=0;
   float camera_rotation_angle,lxg,lx1,zoom;*/
 int flag220=0,flag111=0,flag101=0,flag26=0,flag=0,flag1=0,flag100=0,flag10=0,flag20=0,flag11=0,flag25=0;
-float flag121=0,change=0,value3=0,value2=0,value5=0.4,value6=0.8,change1=0;
+float flag121=0;
+/* The block's two halves on an integer lattice. x and y count LATTICE steps
+   of the board, the height h counts sink steps, SINK_STEPS to a lattice step.
+   Moves and the rules of update() are exact integer compares, world
+   coordinates are only made in draw(), so nothing drifts however long the
+   game runs. */
+#define LATTICE 0.4f
+#define SINK_STEPS 20
+int bx[2]={0,0},by[2]={0,0},bh[2]={SINK_STEPS,2*SINK_STEPS};
 /* Executed when a regular key is pressed/released/held-down */
 /* Prefered for Keyboard events */
 void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	// Function is called first on GLFW_PRESS.
+	trace_instant(TRACE_KEY, key, action);
 
 	if (action == GLFW_RELEASE) {
 		switch (key) {
@@ -323,135 +138,130 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 				break;
 			case GLFW_KEY_UP:
 				//flag=1;
-				system("mpg123 -vC  sound1.mp3 &");
+				audio_play(SOUND_ROLL);
 				moves++;
-				if(abs(value3-value2)<0.01 && value5>value6 && abs(change-change1)<0.01)
+				if(bx[1]==bx[0] && bh[0]>bh[1] && by[0]==by[1])
 				{
 					//	printf("1\n");
-					change1=change1+0.8;
-					change=change+0.4;
-					value5=0.4;
-					value6=0.4;
+					by[1]+=2;
+					by[0]++;
+					bh[0]=SINK_STEPS;
+					bh[1]=SINK_STEPS;
 				}
-				else if(abs(value3-value2)<0.01 && value5<value6 &&abs(change-change1)<0.01)
+				else if(bx[1]==bx[0] && bh[0]<bh[1] &&by[0]==by[1])
 				{
 					//	printf("2\n");
 					//	system("mpg123 -vC  sound1.mp3 &");
-					change1=change1+0.4;
-					change=change+0.8;
-					value6=0.4;
-					value5=0.4;
+					by[1]++;
+					by[0]+=2;
+					bh[1]=SINK_STEPS;
+					bh[0]=SINK_STEPS;
 				}
-				else if(change>change1+0.001)
+				else if(by[0]>by[1])
 				{
 					//	printf("3\n");
 
-					change+=0.4;
-					change1+=0.8;
-					value6=0.8;
-					value5=0.4;
+					by[0]++;
+					by[1]+=2;
+					bh[1]=2*SINK_STEPS;
+					bh[0]=SINK_STEPS;
 				}
-				else if(change<change1-0.01)
+				else if(by[0]<by[1])
 				{
 					//printf("4\n");
-					change+=0.8;
-					change1+=0.4;
-					value5=0.8;
-					value6=0.4;
+					by[0]+=2;
+					by[1]++;
+					bh[0]=2*SINK_STEPS;
+					bh[1]=SINK_STEPS;
 				}
 				else{
 					//	printf("5\n");
-					change=change+0.4;
-					change1=change1+0.4;
-					//	value5=0.4;
-					//	value6=0.4;
+					by[0]++;
+					by[1]++;
+					//	bh[0]=SINK_STEPS;
+					//	bh[1]=SINK_STEPS;
 				}
 				break;
 			case GLFW_KEY_DOWN:
 				moves++;
-				system("mpg123 -vC  sound1.mp3 &");
-				if(abs(value3-value2)<0.01 && value5>value6 && abs(change-change1)<0.01)
+				audio_play(SOUND_ROLL);
+				if(bx[1]==bx[0] && bh[0]>bh[1] && by[0]==by[1])
 				{
-					printf("6\n");
-					change1=change1-0.8;
-					change=change-0.4;
-					value5=0.4;
-					value6=0.4;
+					by[1]-=2;
+					by[0]--;
+					bh[0]=SINK_STEPS;
+					bh[1]=SINK_STEPS;
 				}
-				else if(abs(value3-value2)<0.01 && value5<value6 &&abs(change-change1)<0.01)
+				else if(bx[1]==bx[0] && bh[0]<bh[1] &&by[0]==by[1])
 				{
-					printf("7\n");
-					change1=change1-0.4;
-					change=change-0.8;
-					value6=0.4;
-					value5=0.4;
+					by[1]--;
+					by[0]-=2;
+					bh[1]=SINK_STEPS;
+					bh[0]=SINK_STEPS;
 
 				}
-				else if(change<change1-0.01)
+				else if(by[0]<by[1])
 				{
-					printf("8\n");
-					change=change-0.4;
-					change1=change1-0.8;
-					value6=0.8;
-					value5=0.4;
+					by[0]--;
+					by[1]-=2;
+					bh[1]=2*SINK_STEPS;
+					bh[0]=SINK_STEPS;
 				}
-				else if(change>change1+0.01)
+				else if(by[0]>by[1])
 				{
-					printf("9\n");
-					change=change-0.8;
-					change1=change1-0.4;
-					value5=0.8;
-					value6=0.4;
+					by[0]-=2;
+					by[1]--;
+					bh[0]=2*SINK_STEPS;
+					bh[1]=SINK_STEPS;
 				}
 				else{
-					printf("10\n");
-					change=change-0.4;
-					change1=change1-0.4;
-					//	value6=0.4;
-					//	value5=0.4;
+					by[0]--;
+					by[1]--;
+					//	bh[1]=SINK_STEPS;
+					//	bh[0]=SINK_STEPS;
 				}
 
 				break;
 			case GLFW_KEY_LEFT:
 				moves++;
-				system("mpg123 -vC  sound1.mp3 &");
-				if(abs(value3-value2)<0.01 && value6<value5 && abs(change-change1)<0.01)
+				audio_play(SOUND_ROLL);
+				if(bx[1]==bx[0] && bh[1]<bh[0] && by[0]==by[1])
 				{
-					value3=value3-0.4;
-					value2=value2-0.8;
-					value5=0.4;
-					value6=0.4;
+					bx[1]--;
+					bx[0]-=2;
+					bh[0]=SINK_STEPS;
+					bh[1]=SINK_STEPS;
 
 				}
-				else if(abs(value3-value2)<0.01 && value6>value5 && abs(change-change1)<0.01)
+				else if(bx[1]==bx[0] && bh[1]>bh[0] && by[0]==by[1])
 				{
-					value3=value3-0.8;
-					value2=value2-0.4;
-					value6=0.4;
-					value5=0.4;
+					bx[1]-=2;
+					bx[0]--;
+					bh[1]=SINK_STEPS;
+					bh[0]=SINK_STEPS;
 				}
-				else if(value3>value2 && abs(change-change1)<0.01)
+				else if(bx[1]>bx[0] && by[0]==by[1])
 				{
-					value2=value2-0.4;
-					value3=value3-0.8;
-					value6=0.8;
-					value5=0.4;
+					bx[0]--;
+					bx[1]-=2;
+					bh[1]=2*SINK_STEPS;
+					bh[0]=SINK_STEPS;
 				}
-				else if(value3<value2 && abs(change-change1)<0.01)
+				else if(bx[1]<bx[0] && by[0]==by[1])
 				{
-					value2=value2-0.8;
-					value3=value3-0.4;
-					value5=0.8;
-					value6=0.4;
+					bx[0]-=2;
+					bx[1]--;
+					bh[0]=2*SINK_STEPS;
+					bh[1]=SINK_STEPS;
 				}
-				else if(abs(value3-value2)<0.01 && change!=change1)
+				else if(bx[1]==bx[0] && by[0]!=by[1])
 				{
-					value2=value2-0.4;
-					value3=value3-0.4;
+					bx[0]--;
+					bx[1]--;
 				}
 				else{
-					value2=value2-0.4;
-					value3=value3-0.4;
+					bx[0]--;
+					bx[1]--;
 				}
 
 
@@ -460,41 +270,41 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 				break;
 			case GLFW_KEY_RIGHT:
 				moves++;
-				system("mpg123 -vC  sound1.mp3 &");
-				if(abs(value3-value2)<0.01 && value6<value5 && abs(change-change1)<0.01)
+				audio_play(SOUND_ROLL);
+				if(bx[1]==bx[0] && bh[1]<bh[0] && by[0]==by[1])
 				{
-					value3=value3+0.4;
-					value2=value2+0.8;
-					value5=0.4;
-					value6=0.4;
+					bx[1]++;
+					bx[0]+=2;
+					bh[0]=SINK_STEPS;
+					bh[1]=SINK_STEPS;
 				}
-				else if(abs(value3-value2)<0.01 && value6>value5 && abs(change-change1)<0.01)
+				else if(bx[1]==bx[0] && bh[1]>bh[0] && by[0]==by[1])
 				{
-					value3=value3+0.8;
-					value2=value2+0.4;
-					value6=0.4;
-					value5=0.4;
+					bx[1]+=2;
+					bx[0]++;
+					bh[1]=SINK_STEPS;
+					bh[0]=SINK_STEPS;
 				}
-				else if(value3<value2 && abs(change-change1)<0.01)
+				else if(bx[1]<bx[0] && by[0]==by[1])
 				{
-					value2=value2+0.4;
-					value3=value3+0.8;
-					value6=0.8;
+					bx[0]++;
+					bx[1]+=2;
+					bh[1]=2*SINK_STEPS;
 				}
-				else if(value3>value2)
+				else if(bx[1]>bx[0])
 				{
-					value2=value2+0.8;
-					value3=value3+0.4;
-					value5=0.8;
+					bx[0]+=2;
+					bx[1]++;
+					bh[0]=2*SINK_STEPS;
 				}
-				else if(abs(value3-value2)<0.01 && change!=change1)
+				else if(bx[1]==bx[0] && by[0]!=by[1])
 				{
-					value2+=0.4;
-					value3+=0.4;
+					bx[0]++;
+					bx[1]++;
 				}
 				else{
-					value2=value2+0.4;
-					value3=value3+0.4;
+					bx[0]++;
+					bx[1]++;
 				}
 
 				break;
@@ -524,6 +334,11 @@ void keyboardChar (GLFWwindow* window, unsigned int key)
 /* Executed when a mouse button is pressed/released */
 void mouseButton (GLFWwindow* window, int button, int action, int mods)
 {
+	if (trace_on && action == GLFW_PRESS) {
+		double x, y;
+		glfwGetCursorPos(window, &x, &y);
+		trace_instant(TRACE_MOUSE, (int)x, (int)y);
+	}
 	switch (button) {
 		case GLFW_MOUSE_BUTTON_LEFT:
 			if (action == GLFW_RELEASE)
@@ -861,14 +676,147 @@ float triangle_rotation = 0;
 
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
-void draw ()
+/* The block sinks this much a step once it is off the board */
+int fallen=0; // sink steps in the last step, draw() interpolates them
+void sinkBlock ()
+{
+	bh[0]--;
+	bh[1]--;
+	fallen++;
+}
+
+/* Put the block back at lattice (x,0) lying flat */
+void resetBlock (int x)
+{
+	bx[0]=bx[1]=x;
+	by[0]=by[1]=0;
+	bh[0]=SINK_STEPS;
+	bh[1]=2*SINK_STEPS;
+	fallen=0;
+}
+
+/* One fixed step of 1/TICK_HZ s: falling, level changes and the board of the
+   current level. draw() only draws, so the game runs the same at any frame rate. */
+void update ()
+{
+	fallen=0;
+	if(bx[1]==6 && bx[0]==6 && by[0]==-1 && by[1]==-1 && flag10==0)
+	{
+		flag100=1;
+		sinkBlock();
+	}
+	if((bx[1]<-1 || bx[0]<-1) && flag10==0)
+	{
+		flag220=1;
+		sinkBlock();
+	}
+	if((bx[1]>=0 && bx[1]<=3 && (by[0]<0 || by[1]<0)) && flag10==0)
+	{
+		flag220=1;
+		sinkBlock();
+	}
+
+	if((by[0]>3 || by[1]>3) && flag10==0)
+	{
+		flag220=1;
+		sinkBlock();
+	}
+	if((by[0]<-2 || by[1]<-2) && flag10==0)
+	{
+		flag220=1;
+		sinkBlock();
+	}
+	if(bh[0]<-5*SINK_STEPS &&flag220==0)
+	{
+		resetBlock(-5);
+		flag10=1;
+	}
+	if(bh[0]<-5*SINK_STEPS && flag220==1)
+	{
+		resetBlock(0);
+	}
+	//printf("%d\n",flag100);
+	if(flag100==0)
+	{
+
+		Matrix();
+	}
+	if(flag100==1 && flag10==1 && flag111==0)
+	{
+		flag11=1;
+		//	printf("1\n");
+		Matrix1();
+
+		if((bx[0]==-4 || bx[1]==-4) && (by[0]==2 || by[1]==2))
+		{
+
+			flag25=1;
+		}
+		if(bx[0]==2 && bx[1]==2 && by[0]==2 && by[1]==2)
+		{
+			//	printf("1\n");
+			flag26=1;
+		}
+		if(bx[0]==7 && bx[1]==7 && by[0]==3)
+		{
+			//	printf("Entered\n");
+			flag101=1;
+
+			sinkBlock();
+			flag121=1;
+		}
+
+		if(bh[0]<-5*SINK_STEPS)
+		{
+			resetBlock(-5);
+			flag111=1;
+		}
+		if(bx[0]<-6 || bx[1]<-6 || bx[0]>8 || bx[1]>8)
+		{
+			trace_instant(TRACE_FALL, 2, moves);
+			sinkBlock();
+		}
+		if(by[0]>3 || by[0]<-1 || by[1]>3 || by[1]<-1)
+		{
+			trace_instant(TRACE_FALL, 3, moves);
+			sinkBlock();
+		}
+
+
+
+
+	}
+	if(flag25==1)
+	{
+		a[10][6]=1;a[9][6]=1;
+	}
+	if(flag26==1)
+	{
+		a[4][6]=1;a[3][6]=1;
+	}
+	if(flag101==1 && flag111==1)
+	{
+		Matrix2();
+
+		if(bx[0]>=-2 && bx[0]<=3 && bx[1]<=3 && bx[1]>=-2 && by[0]==by[1] && bx[0]==bx[1] && (by[0]==5 || by[1]==4))
+		{
+			sinkBlock();
+		}
+		if(bx[0]>=4 && bx[0]<=7 && bx[1]<=7 && by[0]==by[1] && bx[0]==bx[1] && by[0]>=-2 && by[0]<=0 && by[1]>=-2)
+		{
+			sinkBlock();
+		}
+	}
+}
+
+void draw (float alpha)
 {
 	// clear the color and depth in the frame buffer
 	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	// use the loaded shader program
 	// Don't change unless you know what you are doing
-	glUseProgram (programID);
+	glstate_use_program(programID);
 
 	// Eye - Location of camera. Don't change unless you are sure!!
 	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
@@ -884,6 +832,10 @@ void draw ()
 
 	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
 	//  Don't change unless you are sure!!
+	// Where the block was between the last two steps
+	float x2=LATTICE*bx[0], x3=LATTICE*bx[1], y2=LATTICE*by[0], y3=LATTICE*by[1];
+	float z5=LATTICE*(bh[0]+fallen*(1-alpha))/SINK_STEPS, z6=LATTICE*(bh[1]+fallen*(1-alpha))/SINK_STEPS;
+
 	count=count%5;
 	if(count==0)
 	{
@@ -904,7 +856,7 @@ void draw ()
 //	glm::mat4 VP = Matrices.projection * Matrices.view;
         if(count==3){
 		heli=1;
-			printf("%f\n",camera_rotation_angle);
+			trace_counter(TRACE_CAMERA, count, (int)camera_rotation_angle);
 		Matrices.projection = glm::ortho(-4.0f/zoom,4.0f/zoom,-4.0f/zoom,4.0f/zoom,0.1f, 500.0f);
 
 		Matrices.view = glm::lookAt(glm::vec3(-6*cos(camera_rotation_angle*M_PI/180),-6*sin(camera_rotation_angle*M_PI/180),4), glm::vec3(0,0,0), glm::vec3(1,1,2));
@@ -914,7 +866,7 @@ void draw ()
 //		Matrices.projection = glm::ortho(-4.0f/zoom,4.0f/zoom,-4.0f/zoom,4.0f/zoom,0.1f, 500.0f);
 	  //      Matrices.view = glm::lookAt(glm::vec3(-6*cos(camera_rotation_angle*M_PI/180),-6*sin(camera_rotation_angle*M_PI/180),4), glm::vec3(0,0,0), glm::vec3(1,1,2));
         Matrices.projection = glm::perspective(0.8f,(GLfloat) 600 / (GLfloat) 600,0.1f, 500.0f);
-	        Matrices.view = glm::lookAt(glm::vec3(value3-0.3,change,value6+0.2), glm::vec3(value3+3,change+0.4,value6-2), glm::vec3(0,0,1));
+	        Matrices.view = glm::lookAt(glm::vec3(x3-0.3,y2,z6+0.2), glm::vec3(x3+3,y2+0.4,z6-2), glm::vec3(0,0,1));
 	}
 	// Send our transformation to the currently bound shader, in the "MVP" uniform
 	// For each model you render, since the MVP will be different (at least the M part)
@@ -967,195 +919,63 @@ glm::mat4 VP = Matrices.projection * Matrices.view;
 	char level_strl[30];
 	sprintf(level_strl,"TIME: %d:%d:%d",ti1,ti2,ti3);
 	glUseProgram(fontProgramID);*/
-	printf("%d\n",moves);
 	Matrices.model = glm::mat4(1.0f);
 
 
-	glm::mat4 translateRectangle = glm::translate (glm::vec3(value3-0.7, change, value6));        // glTranslatef
+	glm::mat4 translateRectangle = glm::translate (glm::vec3(x3-0.7, y2, z6));        // glTranslatef
 	//	glm::mat4 rotateRectangle = glm::rotate((float)(value3), glm::vec3(0.5,change,0.4)); // rotate about vector (-1,1,1)
 	glm::mat4 scaleRectangle = glm::scale (glm::vec3(1,1,4));
 	Matrices.model *= (translateRectangle*scaleRectangle);
 	MVP = VP * Matrices.model;
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	draw3DObject(rectangle3);
+	drawObject(rectangle3, MVP);
 	Matrices.model = glm::mat4(1.0f);
 
 
-	glm::mat4  translateRectangle1 = glm::translate (glm::vec3(value2-0.7,change1, value5));      
+	glm::mat4  translateRectangle1 = glm::translate (glm::vec3(x2-0.7,y3, z5));      
 	// glTranslatef
 	//	glm::mat4 rotateRectangle1 = glm::rotate((float)(value3), glm::vec3(0.5,change,0.4)); // rotate about vector (-1,1,1)
 	glm::mat4 scaleRectangle1 = glm::scale (glm::vec3(1,1,4));
 
 	Matrices.model *= (translateRectangle1*scaleRectangle1);
 	MVP = VP * Matrices.model;
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	draw3DObject(rectangle3);
-	if(abs(value3-2.4)<0.01 && abs(value2-2.4)<0.01 && abs(change+0.4)<0.01 && abs(change1+0.4)<0.01 && flag10==0)
+	drawObject(rectangle3, MVP);
+	// The pressure switches of the second level
+	if(flag100==1 && flag10==1 && flag111==0 && flag121==0)
 	{
-		flag100=1;
-		value5=value5-0.02;
-		value6=value6-0.02;
-	}
-	if((value3<-0.78 || value2<-0.78) && flag10==0)
-	{
-		flag220=1;
-		value5=value5-0.02;
-		value6=value6-0.02;
-	}
-	if((value3>-0.02 && value3<1.22 && (change<-0.38 || change1<-0.38)) && flag10==0)
-	{
-		flag220=1;
-		value5=value5-0.02;
-		value6=value6-0.02;
-	}
-
-	if((change>1.58 || change1>1.58) && flag10==0)
-	{
-		flag220=1;
-		value5=value5-0.02;
-		value6=value6-0.02;
-	}
-	if((change<-1.18 || change1<-1.18) && flag10==0)
-	{
-		flag220=1;
-		value5=value5-0.02;
-		value6=value6-0.02;
-	}
-	if(value5<-2.0 &&flag220==0)
-	{
-		value2=-2;
-		value3=-2;
-		change=0;
-		change1=0;
-		flag10=1;
-		value5=0.4;
-		value6=0.8;
-	}
-	if(value5<-2.0 && flag220==1)
-	{
-		value2=0;
-		value3=0;
-		change=0;
-		change1=0;
-		value5=0.4;
-		value6=0.8;
-	}
-	//printf("%d\n",flag100);
-	if(flag100==0)
-	{
-
-		Matrix();
-	}
-	if(flag100==1 && flag10==1 && flag111==0)
-	{
-		flag11=1;
-		//	printf("1\n");
-		if(flag121==0)
-		{
-			Matrices.model = glm::mat4(1.0f);
-			glm::mat4 translateCircle = glm::translate (glm::vec3(-2.4,0.7,0.3));
-			Matrices.model *= (translateCircle);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(circle);
-		}
-
-		Matrix1();
-
-		if((abs(value2+1.6)<0.01 || abs(value3+1.6)<0.01) && (abs(change-0.8)<0.01 || abs(change1-0.8)<0.01))
-		{
-			//		printf("%f\n",(change-0.8));
-
-			flag25=1;
-		}
-		if(flag121==0)
-		{
-			Matrices.model = glm::mat4(1.0f);
-			glm::mat4 translateCircle1 = glm::translate (glm::vec3(0,0.7,0.3));
-			Matrices.model *= (translateCircle1);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(circle);
-		}
-		//	printf("%f %f\n",change,change1);
-		if(abs(value2-0.8)<0.01 && abs(value3-0.8)<0.01 && abs(change-0.8)<0.01 && abs(change1-0.8)<0.01)
-		{
-			//	printf("1\n");
-			flag26=1;
-		}
-		if(abs(value2-2.8)<0.01 && abs(value3-2.8)<0.01 && abs(change-1.2)<0.01 && abs(change-1.2)<0.01)
-		{
-			//	printf("Entered\n");
-			flag101=1;
-
-			value5=value5-0.02;
-			value6=value6-0.02;
-			flag121=1;
-		}
-
-		if(value5<-2.0)
-		{
-			value5=0.4;
-			value6=0.8;
-			value2=-2;
-			value3=-2;
-			flag111=1;
-			change=0;
-			change1=0;
-
-		}
-		if(value2<-2.79 || value3<-2.79 || value2>3.21 || value3>3.21)
-		{
-			printf("2\n");
-			value5=value5-0.02;
-			value6=value6-0.02;
-		}
-		if(change>1.21 || change<-0.79 || change1>1.21 || change1<-0.79)
-		{
-			printf("3\n");
-			value5=value5-0.02;
-			value6=value6-0.02;
-		}
-
-
-
-
-	}
-	//printf("%f %f\n",value2,change);
-	if(flag25==1)
-	{
-		a[10][6]=1;a[9][6]=1;
-	}
-	if(flag26==1)
-	{
-		a[4][6]=1;a[3][6]=1;
-	}
-	if(flag101==1 && flag111==1)
-	{
-		Matrix2();
-
-		if(value2>-1.19 && value2<1.21 && value3<1.21 && value3>-1.19 && abs(change-change1)<0.01 && abs(value2-value3)<0.01 && (abs(change-2)<0.01 || abs(change1-1.6)<0.01))
-		{
-			value5=value5-0.02;
-			value6=value6-0.02;
-		}
-		//	printf("%f %f %f %f\n",value2,value3,change,change1);
-		if(value2>1.21 && value2<2.81 && value2>1.21 && value3<2.81 && abs(change-change1)<0.01 && abs(value2-value3)<0.01 && change>-1.19 && change<0.01 && change1>-1.19 && change<0.01)
-		{
-			value5=value5-0.02;
-			value6=value6-0.02;
-		}
+		Matrices.model = glm::mat4(1.0f);
+		glm::mat4 translateCircle = glm::translate (glm::vec3(-2.4,0.7,0.3));
+		Matrices.model *= (translateCircle);
+		MVP = VP * Matrices.model;
+		drawObject(circle, MVP);
+
+		Matrices.model = glm::mat4(1.0f);
+		glm::mat4 translateCircle1 = glm::translate (glm::vec3(0,0.7,0.3));
+		Matrices.model *= (translateCircle1);
+		MVP = VP * Matrices.model;
+		drawObject(circle, MVP);
 	}
 
+	// Tiles outside the view are not queued, with the follow camera or zoomed in that is most of them
+	Frustum frustum;
+	frustum_from(&frustum,VP);
+	int visible=0,culled=0;
 	// draw3DObject draws the VAO given to it using current MVP matrix
 	for(int i=0;i<15;i++)
 	{
 		for(int j=0;j<10;j++)
 		{
 			//	printf("%d\n",i);
-			if(a[i][j]==1 )
+			int tile=a[i][j];
+			if(tile==1 || tile==2){
+				// The tile mesh is 0.4 x 0.4 x 0.1
+				if(frustum_box(&frustum,glm::vec3(-x+2.5,-y+2,0.15),glm::vec3(0.2f,0.2f,0.05f)))
+					visible++;
+				else{
+					culled++;
+					tile=0;
+				}
+			}
+			if(tile==1 )
 			{
 				if(((i+j)%2)==0)
 				{
@@ -1168,10 +988,8 @@ glm::mat4 VP = Matrices.projection * Matrices.view;
 					//glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 					Matrices.model *= (translateRectangle);
 					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
 
-					draw3DObject(rectangle1);
+					drawObject(rectangle1, MVP);
 					/*	if(flag11=1)
 						{
 						Matrices.model = glm::mat4(1.0f);
@@ -1192,20 +1010,17 @@ glm::mat4 VP = Matrices.projection * Matrices.view;
 					glm::mat4 scaleRectangle3 = glm::scale(glm::vec3(2,2,1));
 					Matrices.model *= (translateRectangle);
 					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-					draw3DObject(rectangle2);
+					drawObject(rectangle2, MVP);
 				}
 			}
-			else if(a[i][j]==2)
+			else if(tile==2)
 			{
 				Matrices.model=glm::mat4(1.0f);
 				glm::mat4 translateRectangle4 = glm::translate (glm::vec3(-x+2.5,-y+2,0.15));
 				Matrices.model *= (translateRectangle4);
 				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1,GL_FALSE, &MVP[0][0]);
-				draw3DObject(rectangle4);
-				draw3DObject(rectangle5);
+				drawObject(rectangle4, MVP);
+				drawObject(rectangle5, MVP, 1); // the outline over the fill
 			}
 
 
@@ -1215,11 +1030,13 @@ glm::mat4 VP = Matrices.projection * Matrices.view;
 
 	}
 }
+trace_counter(TRACE_TILES,visible,culled);
 float fontScaleValue = 1 ;
 static int fontScale=280;
 glm::vec3 fontColor = getRGBfromHue (fontScale);
 
-glUseProgram(fontProgramID);
+renderq_flush();
+glstate_use_program(fontProgramID);
 
 
 char level_str[30];
@@ -1236,6 +1053,7 @@ MVP = Matrices.projection * Matrices.view * Matrices.model;
 glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
 glUniform3fv(GL3Font.fontColorID, 1, &fontColor[0]);
 GL3Font.font->Render(level_str);
+glstate_invalidate(); // FTGL binds its own buffers and textures
 
 // Increment angles
 float increments = 1;
@@ -1248,7 +1066,7 @@ ti3=(ti-(ti2*60));
 float fontScaleValue1 = 1 ;
 int fontScale1=280;
 glm::vec3 fontColor1= getRGBfromHue(fontScale1);
-glUseProgram(fontProgramID);
+glstate_use_program(fontProgramID);
 
 
 char level_strl[30];
@@ -1269,38 +1087,24 @@ MVP = Matrices.projection * Matrices.view * Matrices.model;
 glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
 glUniform3fv(GL3Font.fontColorID, 1, &fontColor1[0]);
 GL3Font.font->Render(level_strl);
+glstate_invalidate(); // FTGL binds its own buffers and textures
+
+glstate_frame();
 
 //camera_rotation_angle++; // Simulating camera rotation
 /*triangle_rotation = triangle_rotation + increments*triangle_rot_dir*triangle_rot_status;
   rectangle_rotation = rectangle_rotation + increments*rectangle_rot_dir*rectangle_rot_status;*/
 }
 
+int vsync=1; // --no-vsync draws as fast as it can, the game still steps at TICK_HZ
+
 /* Initialise glfw window, I/O callbacks and the renderer to use */
 /* Nothing to Edit here */
 GLFWwindow* initGLFW (int width, int height)
 {
-	GLFWwindow* window; // window desciptor/handle
-
-	glfwSetErrorCallback(error_callback);
-	if (!glfwInit()) {
-		//        exit(EXIT_FAILURE);
-	}
-
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	window = glfwCreateWindow(width, height, "Sample OpenGL 3.3 Application", NULL, NULL);
-
-	if (!window) {
-		glfwTerminate();
-		//        exit(EXIT_FAILURE);
-	}
-
-	glfwMakeContextCurrent(window);
-	gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
-	glfwSwapInterval( 1 );
+	GLFWwindow* window = openWindow(width, height, "Sample OpenGL 3.3 Application", vsync, 1);
+	if (!window)
+		exit(EXIT_FAILURE);
 
 	/* --- register callbacks with GLFW --- */
 
@@ -1335,20 +1139,14 @@ void initGL (GLFWwindow* window, int width, int height)
 	//Matrix();
 	//Matrix1();
 	createCircle();
-	// Create and compile our GLSL program from the shaders
-	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
-	// Get a handle for our "MVP" uniform
-	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+	// The scene program and the depth test
+	initScene( "Sample_GL.vert", "Sample_GL.frag" );
 
 
 	reshapeWindow (window, width, height);
 
 	// Background color of the scene
 	glClearColor (0.3f, 0.3f, 0.3f, 0.3f); // R, G, B, A
-	glClearDepth (1.0f);
-
-	glEnable (GL_DEPTH_TEST);
-	glDepthFunc (GL_LEQUAL);
 	const char* fontfile = "monaco.ttf";
 	GL3Font.font = new FTExtrudeFont(fontfile); // 3D extrude style rendering
 
@@ -1373,12 +1171,10 @@ void initGL (GLFWwindow* window, int width, int height)
 	GL3Font.font->Depth(0);
 	GL3Font.font->Outset(0, 0);
 	GL3Font.font->CharMap(ft_encoding_unicode);
+	glstate_invalidate(); // FTGL binds its own buffers
 
 
-	cout << "VENDOR: " << glGetString(GL_VENDOR) << endl;
-	cout << "RENDERER: " << glGetString(GL_RENDERER) << endl;
-	cout << "VERSION: " << glGetString(GL_VERSION) << endl;
-	cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
+	printGLInfo();
 }
 
 int main (int argc, char** argv)
@@ -1386,15 +1182,31 @@ int main (int argc, char** argv)
 	int width = 600;
 	int height = 600;
 
+	audio_init(AUDIO_DEVICE, NULL);
+	for (int i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "--trace") && i+1<argc)
+			trace_start(argv[++i]);
+		else if (!strcmp(argv[i], "--no-vsync"))
+			vsync = 0;
+	}
+
 	GLFWwindow* window = initGLFW(width, height);
 
 	initGL (window, width, height);
 
 	double last_update_time = glfwGetTime(), current_time;
+	Timestep step;
+	timestep_start(&step, glfwGetTime());
 
 	/* Draw in loop */
 	while (!glfwWindowShouldClose(window)) {
-		draw();
+		trace_begin(TRACE_FRAME);
+		// Advance the game in fixed steps, then draw between the last two
+		for (int n = timestep_advance(&step, glfwGetTime()); n > 0; n--)
+			update();
+		trace_begin(TRACE_DRAW);
+		draw(timestep_alpha(&step));
+		trace_end(TRACE_DRAW);
 		if(heli==1  && lmouse1==1){
 			drag(window);
 		}
@@ -1402,10 +1214,14 @@ int main (int argc, char** argv)
 
 
 		// Swap Frame Buffer in double buffering
+		trace_begin(TRACE_SWAP);
 		glfwSwapBuffers(window);
+		trace_end(TRACE_SWAP);
 
 		// Poll for Keyboard and mouse events
+		trace_begin(TRACE_EVENTS);
 		glfwPollEvents();
+		trace_end(TRACE_EVENTS);
 
 		// Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
 		current_time = glfwGetTime(); // Time in seconds
@@ -1413,8 +1229,11 @@ int main (int argc, char** argv)
 			// do something every 0.5 seconds ..
 			last_update_time = current_time;
 		}
+		trace_end(TRACE_FRAME);
 	}
 
+	trace_stop();
+	audio_shutdown();
 	glfwTerminate();
 	//    exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,26 @@
+#include "board.h"
+
+/* Copy the level's tiles into the board, every tile starting its drop-in */
+void board_load (Board* board, const Level* level)
+{
+	board->rows = level->rows;
+	board->cols = level->cols;
+	board->stride = level->cols;
+	board->cells.resize(board->rows*board->stride);
+
+	for (int i=0; i<board->rows; i++) {
+		BoardCell* cell = &board->cells[i*board->stride];
+		const int* type = &level->tiles[i*level->cols];
+		for (int j=0; j<board->cols; j++) {
+			cell[j].type = type[j];
+			cell[j].y = BOARD_DROP_HEIGHT;
+		}
+	}
+}
+
+/* Empty every cell, the board keeps its size */
+void board_clear (Board* board)
+{
+	for (int k=0; k<(int)board->cells.size(); k++)
+		board->cells[k].type = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <vector>
+#include "level.h"
+
+/*
+ * The board being played, any size. Cells are kept row major in one flat
+ * array (row r starts at r*stride) with the tile type and the tile's
+ * drop-in height next to each other, so walking a row touches one
+ * contiguous run of memory.
+ */
+
+#define BOARD_DROP_HEIGHT -60 // tiles start this far below the board and rise into place
+
+struct BoardCell {
+	int type; // tile type, see level.h
+	float y;  // drop-in height, 0 once the tile has landed
+};
+
+struct Board {
+	int rows, cols;
+	int stride;
+	std::vector<BoardCell> cells;
+};
+
+void board_load (Board* board, const Level* level);
+void board_clear (Board* board);
+
+inline BoardCell* board_cell (Board* board, int row, int col)
+{
+	return &board->cells[row*board->stride + col];
+}
+
+/* Tile type of a cell, cells off the board are empty */
+inline int board_tile (const Board* board, int row, int col)
+{
+	if (row < 0 || col < 0 || row >= board->rows || col >= board->cols)
+		return 0;
+	return board->cells[row*board->stride + col].type;
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <glad/glad.h>
+#include "capture.h"
+#include "engine.h"
+
+#define CAPTURE_LAG 3 // PBOs in the ring, a frame is written this many frames after it was drawn
+
+struct Capture {
+	int width, height, format;
+	const char* dir;
+	GLuint fbo, color, depth;
+	GLuint pbo[CAPTURE_LAG];
+	int frame[CAPTURE_LAG]; // frame held by each PBO, -1 if none
+	int next;
+	std::vector<unsigned char> rows; // flipped copy for writing
+} Cap;
+
+/* PNG needs a CRC-32 per chunk and an Adler-32 over the zlib stream */
+static uint32_t crc_table[256];
+
+static void crc_init ()
+{
+	for (uint32_t n=0; n<256; n++) {
+		uint32_t c = n;
+		for (int k=0; k<8; k++)
+			c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		crc_table[n] = c;
+	}
+}
+
+static uint32_t crc (uint32_t c, const unsigned char* buf, size_t len)
+{
+	for (size_t i=0; i<len; i++)
+		c = crc_table[(c ^ buf[i]) & 0xff] ^ (c >> 8);
+	return c;
+}
+
+static void put32 (unsigned char* p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void chunk (FILE* f, const char* type, const unsigned char* data, uint32_t len)
+{
+	unsigned char head[8];
+	put32(head, len);
+	for (int i=0; i<4; i++)
+		head[4+i] = type[i];
+	uint32_t c = crc(0xffffffffu, head + 4, 4);
+	c = crc(c, data, len) ^ 0xffffffffu;
+	unsigned char tail[4];
+	put32(tail, c);
+	fwrite(head, 1, 8, f);
+	fwrite(data, 1, len, f);
+	fwrite(tail, 1, 4, f);
+}
+
+/* pixels: top row first, 4 bytes a pixel */
+static void write_png (FILE* f, const unsigned char* pixels, int width, int height)
+{
+	static const unsigned char signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+	fwrite(signature, 1, 8, f);
+
+	unsigned char ihdr[13];
+	put32(ihdr, width);
+	put32(ihdr + 4, height);
+	ihdr[8] = 8;  // bits per channel
+	ihdr[9] = 6;  // RGBA
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+	chunk(f, "IHDR", ihdr, 13);
+
+	// Every row gets filter type 0, the zlib stream is made of stored deflate blocks
+	size_t stride = 4*width + 1;
+	size_t raw_len = stride*height;
+	std::vector<unsigned char> raw(raw_len);
+	for (int y=0; y<height; y++) {
+		raw[y*stride] = 0;
+		memcpy(&raw[y*stride + 1], pixels + (size_t)y*4*width, 4*width);
+	}
+
+	std::vector<unsigned char> z;
+	z.reserve(raw_len + raw_len/65535*5 + 16);
+	z.push_back(0x78);
+	z.push_back(0x01);
+	uint32_t a = 1, b = 0;
+	for (size_t pos=0; pos<raw_len; ) {
+		size_t n = raw_len - pos;
+		if (n > 65535)
+			n = 65535;
+		z.push_back(pos + n == raw_len); // final block flag
+		z.push_back(n & 0xff);
+		z.push_back(n >> 8);
+		z.push_back(~n & 0xff);
+		z.push_back((~n >> 8) & 0xff);
+		z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+		for (size_t i=pos; i<pos+n; i++) {
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		pos += n;
+	}
+	unsigned char adler[4];
+	put32(adler, (b << 16) | a);
+	z.insert(z.end(), adler, adler + 4);
+	chunk(f, "IDAT", &z[0], z.size());
+	chunk(f, "IEND", NULL, 0);
+}
+
+int capture_init (int width, int height, int format, const char* dir)
+{
+	Cap.width = width;
+	Cap.height = height;
+	Cap.format = format;
+	Cap.dir = dir;
+	crc_init();
+
+	glGenFramebuffers(1, &Cap.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, Cap.fbo);
+	glGenRenderbuffers(1, &Cap.color);
+	glBindRenderbuffer(GL_RENDERBUFFER, Cap.color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, Cap.color);
+	glGenRenderbuffers(1, &Cap.depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, Cap.depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, Cap.depth);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "Error: Offscreen framebuffer incomplete (0x%x)\n", status);
+		return -1;
+	}
+
+	for (int i=0; i<CAPTURE_LAG; i++) {
+		Cap.pbo[i] = genBuffer();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, Cap.pbo[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)4*width*height, NULL, GL_STREAM_READ);
+		Cap.frame[i] = -1;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	Cap.next = 0;
+	return 0;
+}
+
+void capture_begin ()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, Cap.fbo);
+	glViewport(0, 0, Cap.width, Cap.height);
+}
+
+/* Write out the frame held by PBO i */
+static void write_frame (int i)
+{
+	if (Cap.frame[i] < 0)
+		return;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, Cap.pbo[i]);
+	const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)4*Cap.width*Cap.height, GL_MAP_READ_BIT);
+	if (pixels) {
+		// GL rows run bottom up
+		size_t stride = 4*Cap.width;
+		Cap.rows.resize(stride*Cap.height);
+		for (int y=0; y<Cap.height; y++)
+			memcpy(&Cap.rows[y*stride], pixels + (Cap.height-1-y)*stride, stride);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		char path[512];
+		snprintf(path, sizeof(path), "%s/frame%05d.%s", Cap.dir, Cap.frame[i], Cap.format == CAPTURE_PNG ? "png" : "rgba");
+		FILE* f = fopen(path, "wb");
+		if (!f)
+			fprintf(stderr, "Error: Could not write `%s'\n", path);
+		else {
+			if (Cap.format == CAPTURE_PNG)
+				write_png(f, &Cap.rows[0], Cap.width, Cap.height);
+			else
+				fwrite(&Cap.rows[0], 1, Cap.rows.size(), f);
+			fclose(f);
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	Cap.frame[i] = -1;
+}
+
+void capture_end (int frame)
+{
+	if (Cap.format != CAPTURE_NONE) {
+		// The PBO about to be reused holds the oldest frame, which is done by now
+		int i = Cap.next;
+		write_frame(i);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, Cap.pbo[i]);
+		glReadPixels(0, 0, Cap.width, Cap.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		Cap.frame[i] = frame;
+		Cap.next = (i + 1) % CAPTURE_LAG;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void capture_finish ()
+{
+	for (int k=0; k<CAPTURE_LAG; k++)
+		write_frame((Cap.next + k) % CAPTURE_LAG);
+}
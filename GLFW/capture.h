@@ -0,0 +1,28 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+/*
+ * Offscreen rendering for headless runs. Frames are drawn into an FBO
+ * instead of the window and, if a directory is given, read back through a
+ * ring of pixel buffer objects: glReadPixels of frame n only queues a copy,
+ * and the frame is written out CAPTURE_LAG frames later when the copy has
+ * long finished, so the readback never stalls the pipeline.
+ *
+ * Frames are written as dir/frame00000.png (8-bit RGBA, stored without
+ * compression so no zlib is needed) or dir/frame00000.rgba (raw RGBA rows,
+ * top row first).
+ */
+
+enum CaptureFormat {
+	CAPTURE_NONE, // render offscreen, write nothing
+	CAPTURE_PNG,
+	CAPTURE_RAW
+};
+
+/* Needs the GL context, returns -1 if the FBO can't be created */
+int capture_init (int width, int height, int format, const char* dir);
+void capture_begin ();         // bind the FBO, call before drawing a frame
+void capture_end (int frame);  // queue the readback of the frame just drawn
+void capture_finish ();        // write out the frames still in flight
+
+#endif
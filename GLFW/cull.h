@@ -0,0 +1,44 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <cmath>
+#include <glm/glm.hpp>
+
+/*
+ * View frustum culling of axis aligned boxes. The six clip planes are
+ * taken straight from the view-projection matrix (Gribb and Hartmann), so
+ * this works the same for the ortho cameras, their zoom and the
+ * perspective follow cameras.
+ */
+
+struct Frustum {
+	glm::vec4 plane[6]; // inside where dot(plane.xyz, p) + plane.w >= 0
+};
+
+inline void frustum_from (Frustum* f, const glm::mat4& VP)
+{
+	// Row r of a column major glm matrix
+	glm::vec4 row[4];
+	for (int r=0; r<4; r++)
+		row[r] = glm::vec4(VP[0][r], VP[1][r], VP[2][r], VP[3][r]);
+	// -w <= x,y,z <= w in clip space
+	for (int i=0; i<3; i++) {
+		f->plane[2*i] = row[3] + row[i];
+		f->plane[2*i+1] = row[3] - row[i];
+	}
+}
+
+/* 0 if the box is wholly outside one of the planes. Boxes near a corner of
+   the frustum can pass without being on screen, which only costs a draw. */
+inline int frustum_box (const Frustum* f, glm::vec3 center, glm::vec3 half)
+{
+	for (int k=0; k<6; k++) {
+		const glm::vec4& p = f->plane[k];
+		float r = half.x*fabsf(p.x) + half.y*fabsf(p.y) + half.z*fabsf(p.z);
+		if (p.x*center.x + p.y*center.y + p.z*center.z + p.w < -r)
+			return 0;
+	}
+	return 1;
+}
+
+#endif
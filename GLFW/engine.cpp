@@ -0,0 +1,451 @@
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "engine.h"
+#include "glstate.h"
+#include "renderq.h"
+
+GLMatrices Matrices;
+GLuint programID;
+
+int gl_buffers_alive=0;
+int gl_vertex_arrays_alive=0;
+
+const char* shader_cache_dir="shadercache";
+
+static std::map<uint64_t, GLuint> programs; // linked programs by the hash of their sources
+static std::mutex programs_lock;            // LoadShaders() also runs on the --watch thread
+
+/* The whole file in one read, 0 if it can't be read */
+static int readFile (const char* path, std::string* out)
+{
+	FILE* f=fopen(path, "rb");
+	if(!f)
+		return 0;
+	fseek(f, 0, SEEK_END);
+	long size=ftell(f);
+	fseek(f, 0, SEEK_SET);
+	out->resize(size);
+	size_t got=size>0 ? fread(&(*out)[0], 1, size, f) : 0;
+	fclose(f);
+	out->resize(got);
+	return 1;
+}
+
+/* 64 bit FNV-1a, continued from h */
+static uint64_t hashBytes (const void* data, size_t size, uint64_t h)
+{
+	const unsigned char* p=(const unsigned char*)data;
+	for(size_t i=0; i<size; i++)
+		h=(h^p[i])*0x100000001b3ULL;
+	return h;
+}
+
+static uint64_t hashString (const char* s, uint64_t h)
+{
+	return hashBytes(s, strlen(s)+1, h); // the NUL keeps "ab"+"c" apart from "a"+"bc"
+}
+
+/* Print an info log only if the driver had something to say */
+static void printLog (const char* what, const std::vector<char>& log)
+{
+	if(log.size()>1 && log[0])
+		fprintf(stdout, "%s: %s\n", what, &log[0]);
+}
+
+static GLuint compileShader (GLenum type, const char* path, const std::string& code)
+{
+	GLuint id=glCreateShader(type);
+	const char* source=code.c_str();
+	glShaderSource(id, 1, &source, NULL);
+	glCompileShader(id);
+
+	GLint length=0;
+	glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+	std::vector<char> log(std::max(length, 1));
+	glGetShaderInfoLog(id, log.size(), NULL, &log[0]);
+	printLog(path, log);
+	return id;
+}
+
+static int programBinaries ()
+{
+	if(!shader_cache_dir || !(GLAD_GL_ARB_get_program_binary || GLAD_GL_VERSION_4_1))
+		return 0;
+	GLint formats=0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats>0;
+}
+
+/* A program from the binary cache, 0 if there is none or the driver no longer takes it */
+static GLuint loadBinary (const char* path)
+{
+	std::string data;
+	if(!readFile(path, &data) || data.size()<=sizeof(uint32_t))
+		return 0;
+	uint32_t format;
+	memcpy(&format, data.data(), sizeof(format));
+	GLuint id=glCreateProgram();
+	glProgramBinary(id, format, data.data()+sizeof(format), data.size()-sizeof(format));
+	GLint linked=GL_FALSE;
+	glGetProgramiv(id, GL_LINK_STATUS, &linked);
+	if(!linked){
+		glDeleteProgram(id);
+		return 0;
+	}
+	return id;
+}
+
+static void saveBinary (const char* path, GLuint id)
+{
+	GLint length=0;
+	glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length<=0)
+		return;
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(id, length, &length, &format, &binary[0]);
+
+	mkdir(shader_cache_dir, 0755);
+	FILE* f=fopen(path, "wb");
+	if(!f)
+		return;
+	uint32_t f32=format;
+	fwrite(&f32, sizeof(f32), 1, f);
+	fwrite(&binary[0], 1, length, f);
+	fclose(f);
+}
+
+/* Load, compile and link a vertex and fragment shader. A program is made once
+   per pair of sources: loading the same sources again returns the same
+   program, and with shader_cache_dir set the linked binary is kept there
+   (one file per hash of the sources and the driver) so the next start
+   skips compiling. Shader and link logs are printed when not empty. A
+   program that doesn't link is returned but not kept, the caller checks
+   GL_LINK_STATUS and the next load compiles again. */
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
+
+	// Held throughout, so the same sources loaded on two threads are linked once
+	std::lock_guard<std::mutex> lock(programs_lock);
+
+	std::string VertexShaderCode, FragmentShaderCode;
+	if(!readFile(vertex_file_path, &VertexShaderCode))
+		fprintf(stderr, "Can't read shader %s\n", vertex_file_path);
+	if(!readFile(fragment_file_path, &FragmentShaderCode))
+		fprintf(stderr, "Can't read shader %s\n", fragment_file_path);
+
+	uint64_t key=hashString(VertexShaderCode.c_str(), 0xcbf29ce484222325ULL);
+	key=hashString(FragmentShaderCode.c_str(), key);
+	std::map<uint64_t, GLuint>::iterator it=programs.find(key);
+	if(it!=programs.end())
+		return it->second;
+
+	// A binary only fits the driver that made it
+	int binaries=programBinaries();
+	char path[256];
+	if(binaries){
+		const GLenum strings[]={ GL_VENDOR, GL_RENDERER, GL_VERSION };
+		uint64_t driver=key;
+		for(int k=0; k<3; k++)
+			driver=hashString((const char*)glGetString(strings[k]), driver);
+		snprintf(path, sizeof(path), "%s/%016llx.bin", shader_cache_dir, (unsigned long long)driver);
+		GLuint ProgramID=loadBinary(path);
+		if(ProgramID){
+			programs[key]=ProgramID;
+			return ProgramID;
+		}
+	}
+
+	GLuint VertexShaderID=compileShader(GL_VERTEX_SHADER, vertex_file_path, VertexShaderCode);
+	GLuint FragmentShaderID=compileShader(GL_FRAGMENT_SHADER, fragment_file_path, FragmentShaderCode);
+
+	// Link the program
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, VertexShaderID);
+	glAttachShader(ProgramID, FragmentShaderID);
+	if(binaries)
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(ProgramID);
+
+	// Check the program
+	GLint Result = GL_FALSE, InfoLogLength = 0;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	std::vector<char> ProgramErrorMessage( std::max(InfoLogLength, int(1)) );
+	glGetProgramInfoLog(ProgramID, ProgramErrorMessage.size(), NULL, &ProgramErrorMessage[0]);
+	printLog("link", ProgramErrorMessage);
+
+	glDetachShader(ProgramID, VertexShaderID);
+	glDetachShader(ProgramID, FragmentShaderID);
+	glDeleteShader(VertexShaderID);
+	glDeleteShader(FragmentShaderID);
+
+	if(!Result){
+		fprintf(stderr, "Error: Could not link shaders `%s' `%s'\n", vertex_file_path, fragment_file_path);
+		return ProgramID;
+	}
+	if(binaries)
+		saveBinary(path, ProgramID);
+	programs[key]=ProgramID;
+	return ProgramID;
+}
+
+void deleteProgram (GLuint id)
+{
+	std::lock_guard<std::mutex> lock(programs_lock);
+	for(std::map<uint64_t, GLuint>::iterator it=programs.begin(); it!=programs.end(); ++it)
+		if(it->second==id){
+			programs.erase(it);
+			break;
+		}
+	glDeleteProgram(id);
+}
+
+GLuint genBuffer ()
+{
+	GLuint id;
+	glGenBuffers (1, &id);
+	gl_buffers_alive++;
+	return id;
+}
+
+void deleteBuffer (GLuint id)
+{
+	// GL unbinds a buffer it deletes, the cache has to agree
+	if (glstate.current[GLS_ARRAY_BUFFER] == id)
+		glstate.current[GLS_ARRAY_BUFFER] = 0;
+	glDeleteBuffers (1, &id);
+	gl_buffers_alive--;
+}
+
+GLuint genVertexArray ()
+{
+	GLuint id;
+	glGenVertexArrays (1, &id);
+	gl_vertex_arrays_alive++;
+	return id;
+}
+
+void deleteVertexArray (GLuint id)
+{
+	// GL unbinds a VAO it deletes, the cache has to agree
+	if (glstate.current[GLS_VERTEX_ARRAY] == id)
+		glstate.current[GLS_VERTEX_ARRAY] = 0;
+	glDeleteVertexArrays (1, &id);
+	gl_vertex_arrays_alive--;
+}
+
+void packColor (GLubyte* out, const GLfloat* color)
+{
+	for (int k=0; k<3; k++)
+		out[k] = (GLubyte)(std::min(std::max(color[k], 0.0f), 1.0f)*255 + 0.5f);
+	out[3] = 255;
+}
+
+/* Interleave positions and colors into one VBO. color_step is 3 for a color per
+   vertex or 0 for one color shared by all vertices. */
+GLuint uploadMesh (int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, int color_step, int packed)
+{
+	GLuint id = genBuffer();
+	glstate_bind_array_buffer(id);
+	if (packed) {
+		std::vector<PackedVertex> v(numVertices);
+		for (int i=0; i<numVertices; i++) {
+			memcpy(v[i].pos, vertex_buffer_data + 3*i, sizeof(v[i].pos));
+			packColor(v[i].color, color_buffer_data + color_step*i);
+		}
+		glBufferData (GL_ARRAY_BUFFER, numVertices*sizeof(PackedVertex), &v[0], GL_STATIC_DRAW);
+	}
+	else {
+		std::vector<Vertex> v(numVertices);
+		for (int i=0; i<numVertices; i++) {
+			memcpy(v[i].pos, vertex_buffer_data + 3*i, sizeof(v[i].pos));
+			memcpy(v[i].color, color_buffer_data + color_step*i, sizeof(v[i].color));
+		}
+		glBufferData (GL_ARRAY_BUFFER, numVertices*sizeof(Vertex), &v[0], GL_STATIC_DRAW);
+	}
+	return id;
+}
+
+/* Generate a VAO over an interleaved mesh VBO and return VAO handle - the attributes are set up once here */
+struct VAO* createMeshObject (GLenum primitive_mode, int numVertices, GLuint buffer, int packed, GLenum fill_mode)
+{
+	struct VAO* vao = new struct VAO;
+	vao->PrimitiveMode = primitive_mode;
+	vao->NumVertices = numVertices;
+	vao->FillMode = fill_mode;
+	vao->Buffer = buffer;
+	vao->Packed = packed;
+
+	// Create Vertex Array Object
+	// Should be done after CreateWindow and before any other GL calls
+	vao->VertexArrayID = genVertexArray(); // VAO
+
+	GLsizei stride = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+	glstate_bind_vertex_array(vao->VertexArrayID); // Bind the VAO 
+	glstate_bind_array_buffer(vao->Buffer); // Bind the VBO 
+	glVertexAttribPointer(
+			0,                  // attribute 0. Vertices
+			3,                  // size (x,y,z)
+			GL_FLOAT,           // type
+			GL_FALSE,           // normalized?
+			stride,             // stride
+			(void*)0            // array buffer offset
+			);
+	glEnableVertexAttribArray(0);
+
+	if (packed)
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(PackedVertex, color)); // attribute 1. Color, bytes read as 0..1
+	else
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, color));              // attribute 1. Color (r,g,b)
+	glEnableVertexAttribArray(1);
+	glstate_bind_vertex_array(0);
+
+	return vao;
+}
+
+/* Generate VAO, VBO and return VAO handle */
+struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode, int packed)
+{
+	GLuint buffer = uploadMesh(numVertices, vertex_buffer_data, color_buffer_data, 3, packed);
+	return createMeshObject(primitive_mode, numVertices, buffer, packed, fill_mode);
+}
+
+/* Generate VAO, VBO and return VAO handle - Common Color for all vertices, stored packed */
+struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode)
+{
+	const GLfloat color[3] = { red, green, blue };
+	GLuint buffer = uploadMesh(numVertices, vertex_buffer_data, color, 0, 1);
+	return createMeshObject(primitive_mode, numVertices, buffer, 1, fill_mode);
+}
+
+/* Delete the VAO and its VBO */
+void deleteObject (struct VAO* vao)
+{
+	deleteVertexArray(vao->VertexArrayID);
+	deleteBuffer(vao->Buffer);
+	delete vao;
+}
+
+/* Render the VBO handled by VAO */
+void draw3DObject (struct VAO* vao)
+{
+	// Change the Fill Mode for this object
+	glstate_polygon_mode(vao->FillMode);
+
+	// Bind the VAO to use, it already knows the VBO and its attributes
+	glstate_bind_vertex_array(vao->VertexArrayID);
+
+	// Draw the geometry !
+	glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
+}
+
+/* Queue the VAO with the scene program, it is drawn at the end of the frame
+   by renderq_flush(). An overlay on a coplanar 2D panel goes on layer 1. */
+void drawObject (struct VAO* vao, glm::mat4 MVP, int layer)
+{
+	renderq_add(layer, programID, Matrices.MatrixID, vao->VertexArrayID, vao->PrimitiveMode, vao->NumVertices, vao->FillMode, &MVP[0][0]);
+}
+
+glm::vec3 getRGBfromHue (int hue)
+{
+	float intp;
+	float fracp = modff(hue/60.0, &intp);
+	float x = 1.0 - fabs((float)((int)intp%2)+fracp-1.0);
+	float y=1;
+	if(hue==100){
+		return glm::vec3(1,1,1);
+
+	}
+	else{
+		if (hue < 60)
+			return glm::vec3(1,x,0);
+		else if (hue < 120)
+			return glm::vec3(x,1,0);
+		else if (hue < 180)
+			return glm::vec3(0,1,x);
+		else if (hue < 240)
+			return glm::vec3(0,x,1);
+		else if (hue < 300)
+			return glm::vec3(x,0,1);
+		else
+			return glm::vec3(1,0,x);
+
+	}
+}
+
+float dragAngle (double x, double press_x)
+{
+	return -(x-press_x)/800;
+}
+
+static void error_callback(int error, const char* description)
+{
+	fprintf(stderr, "Error: %s\n", description);
+}
+
+GLFWwindow* openWindow (int width, int height, const char* title, int vsync, int visible)
+{
+	GLFWwindow* window; // window desciptor/handle
+
+	glfwSetErrorCallback(error_callback);
+	if (!glfwInit())
+		return NULL;
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if(!visible)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	window = glfwCreateWindow(width, height, title, NULL, NULL);
+
+	if (!window) {
+		glfwTerminate();
+		return NULL;
+	}
+
+	glfwMakeContextCurrent(window);
+	gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+	glfwSwapInterval( vsync );
+
+	return window;
+}
+
+GLFWwindow* openSharedContext (GLFWwindow* window)
+{
+	// The context hints of openWindow() are still set
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* shared = glfwCreateWindow(1, 1, "", NULL, window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	return shared;
+}
+
+void initScene (const char* vertex_file_path, const char* fragment_file_path)
+{
+	// Create and compile our GLSL program from the shaders
+	programID = LoadShaders( vertex_file_path, fragment_file_path );
+	// Get a handle for our "MVP" uniform
+	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+
+	glClearDepth (1.0f);
+	glEnable (GL_DEPTH_TEST);
+	glDepthFunc (GL_LEQUAL);
+}
+
+void printGLInfo ()
+{
+	printf("VENDOR: %s\n", glGetString(GL_VENDOR));
+	printf("RENDERER: %s\n", glGetString(GL_RENDERER));
+	printf("VERSION: %s\n", glGetString(GL_VERSION));
+	printf("GLSL: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
+}
@@ -0,0 +1,110 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include <glm/glm.hpp>
+
+/*
+ * The rendering code both games are built on: shader loading, meshes and
+ * their VAOs, the queued draw of an object, the window and the GL state
+ * every scene starts from. libengine.a holds it together with glstate,
+ * renderq, trace, audio, watch, ui and glad, so sample2D, blox and bench link
+ * the one copy and glad.c is compiled once.
+ */
+
+struct VAO {
+	GLuint VertexArrayID;
+	GLuint Buffer; // positions and colors interleaved
+	int Packed;    // colors are RGBA8 (PackedVertex), else floats (Vertex)
+
+	GLenum PrimitiveMode;
+	GLenum FillMode;
+	int NumVertices;
+};
+typedef struct VAO VAO;
+
+struct GLMatrices {
+	glm::mat4 projection;
+	glm::mat4 model;
+	glm::mat4 view;
+	GLuint MatrixID;
+};
+
+extern GLMatrices Matrices;
+extern GLuint programID; // the scene program, drawObject() queues with it
+
+/* Vertex formats of the meshes: position and color interleaved in one VBO */
+struct Vertex {       // 24 bytes
+	GLfloat pos[3];
+	GLfloat color[3];
+};
+struct PackedVertex { // 16 bytes, the color as normalized RGBA8
+	GLfloat pos[3];
+	GLubyte color[4];
+};
+
+/* Number of GL objects currently alive - every VBO and VAO is created and deleted through
+   genBuffer/deleteBuffer and genVertexArray/deleteVertexArray, bench checks they don't grow from one pass over the levels to the next */
+extern int gl_buffers_alive;
+extern int gl_vertex_arrays_alive;
+
+GLuint genBuffer ();
+void deleteBuffer (GLuint id);
+GLuint genVertexArray ();
+void deleteVertexArray (GLuint id);
+
+/* Where LoadShaders() keeps linked program binaries, NULL to always compile */
+extern const char* shader_cache_dir;
+
+GLuint LoadShaders (const char* vertex_file_path, const char* fragment_file_path);
+
+/* Delete a program LoadShaders() returned, loading its sources again compiles them */
+void deleteProgram (GLuint id);
+
+void packColor (GLubyte* out, const GLfloat* color);
+
+/* Interleave positions and colors into one VBO. color_step is 3 for a color per
+   vertex or 0 for one color shared by all vertices. */
+GLuint uploadMesh (int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, int color_step, int packed);
+
+/* A VAO over an interleaved mesh VBO, the attributes are set up once here */
+VAO* createMeshObject (GLenum primitive_mode, int numVertices, GLuint buffer, int packed, GLenum fill_mode=GL_FILL);
+
+/* Upload a mesh and make its VAO, with a color per vertex or one common color (stored packed) */
+VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL, int packed=0);
+VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL);
+
+/* Delete a VAO made by createMeshObject() or create3DObject() together with its VBO */
+void deleteObject (VAO* vao);
+
+/* Draw the VAO now with the bound program and MVP */
+void draw3DObject (VAO* vao);
+
+/* Queue the VAO with the scene program, it is drawn at the end of the frame
+   by renderq_flush(). An overlay on a coplanar 2D panel goes on layer 1. */
+void drawObject (VAO* vao, glm::mat4 MVP, int layer=0);
+
+glm::vec3 getRGBfromHue (int hue);
+
+/* Rotation of the dragged camera for the cursor at x, dragged from press_x */
+float dragAngle (double x, double press_x);
+
+/* A GL 3.3 core window with its context current and glad loaded, NULL if
+   GLFW or the window can't be set up. The caller registers its callbacks. */
+GLFWwindow* openWindow (int width, int height, const char* title, int vsync, int visible);
+
+/* An invisible window whose context shares objects (programs, buffers,
+   textures) with window's, to build them on another thread */
+GLFWwindow* openSharedContext (GLFWwindow* window);
+
+/* Build the scene program and set the depth test every scene uses */
+void initScene (const char* vertex_file_path, const char* fragment_file_path);
+
+void printGLInfo ();
+
+#endif
@@ -0,0 +1,22 @@
+#include <cstring>
+#include "glstate.h"
+
+#define GLSTATE_UNKNOWN 0xffffffffu // matches no real object or mode
+
+GLState glstate = { { GLSTATE_UNKNOWN, GLSTATE_UNKNOWN, GLSTATE_UNKNOWN, GLSTATE_UNKNOWN, GLSTATE_UNKNOWN, GLSTATE_UNKNOWN } };
+
+const char* glstate_names[GLS_KINDS] = {
+	"program", "vao", "buffer", "texture", "polygon", "blend"
+};
+
+void glstate_invalidate ()
+{
+	for (int k=0; k<GLS_KINDS; k++)
+		glstate.current[k] = GLSTATE_UNKNOWN;
+}
+
+void glstate_frame ()
+{
+	glstate.last = glstate.counts;
+	memset(&glstate.counts, 0, sizeof(glstate.counts));
+}
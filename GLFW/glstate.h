@@ -0,0 +1,96 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+/*
+ * Cache of the GL state the drawing code switches. All binds and switches
+ * go through these calls, which skip the GL call when the state is already
+ * current. Each kind of state counts the calls it passed on and the ones
+ * it skipped; glstate_frame() closes a frame's counts.
+ *
+ * Textures are only ever bound on unit 0. Code that changes this state
+ * behind the cache's back (FTGL in blox) must call glstate_invalidate()
+ * afterwards.
+ */
+
+enum GLStateKind {
+	GLS_PROGRAM,
+	GLS_VERTEX_ARRAY,
+	GLS_ARRAY_BUFFER,
+	GLS_TEXTURE,
+	GLS_POLYGON_MODE,
+	GLS_BLEND,
+	GLS_KINDS
+};
+
+struct GLStateCounts {
+	int changes[GLS_KINDS]; // calls passed on to GL
+	int skipped[GLS_KINDS]; // calls dropped, the state was current
+};
+
+struct GLState {
+	GLuint current[GLS_KINDS];
+	GLStateCounts counts; // this frame so far
+	GLStateCounts last;   // the last finished frame
+};
+
+extern GLState glstate;
+extern const char* glstate_names[GLS_KINDS];
+
+void glstate_invalidate (); // forget the current state, the next call of each kind goes to GL
+void glstate_frame ();      // end of a frame, its counts move to glstate.last
+
+/* 1 if the state has to change, counted either way */
+inline int glstate_change (int kind, GLuint value)
+{
+	if (glstate.current[kind] == value) {
+		glstate.counts.skipped[kind]++;
+		return 0;
+	}
+	glstate.current[kind] = value;
+	glstate.counts.changes[kind]++;
+	return 1;
+}
+
+inline void glstate_use_program (GLuint program)
+{
+	if (glstate_change(GLS_PROGRAM, program))
+		glUseProgram(program);
+}
+
+inline void glstate_bind_vertex_array (GLuint vao)
+{
+	if (glstate_change(GLS_VERTEX_ARRAY, vao))
+		glBindVertexArray(vao);
+}
+
+inline void glstate_bind_array_buffer (GLuint buffer)
+{
+	if (glstate_change(GLS_ARRAY_BUFFER, buffer))
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+}
+
+inline void glstate_bind_texture (GLuint texture)
+{
+	if (glstate_change(GLS_TEXTURE, texture))
+		glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+inline void glstate_polygon_mode (GLenum mode)
+{
+	if (glstate_change(GLS_POLYGON_MODE, mode))
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+inline void glstate_blend (int on)
+{
+	if (glstate_change(GLS_BLEND, on)) {
+		if (on)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+	}
+}
+
+#endif
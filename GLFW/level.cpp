@@ -0,0 +1,201 @@
+#include <cstdio>
+#include <cstring>
+#include "level.h"
+
+/* Cursor over the level text - the parser never goes back */
+struct LevelReader {
+	const char* p;
+	const char* end;
+	int line;
+};
+
+static void skip_blanks (LevelReader* r)
+{
+	while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\r'))
+		r->p++;
+}
+
+/* Skip the rest of the line, comments included */
+static void next_line (LevelReader* r)
+{
+	while (r->p < r->end && *r->p != '\n')
+		r->p++;
+	if (r->p < r->end) {
+		r->p++;
+		r->line++;
+	}
+}
+
+static int at_line_end (LevelReader* r)
+{
+	skip_blanks(r);
+	return r->p >= r->end || *r->p == '\n' || *r->p == '#';
+}
+
+static int read_word (LevelReader* r, char* word, int size)
+{
+	skip_blanks(r);
+	int n = 0;
+	while (r->p < r->end && *r->p > ' ' && *r->p != '#') {
+		if (n < size-1)
+			word[n++] = *r->p;
+		r->p++;
+	}
+	word[n] = 0;
+	return n;
+}
+
+static int read_int (LevelReader* r, int* value)
+{
+	skip_blanks(r);
+	int sign = 1, digits = 0, v = 0;
+	if (r->p < r->end && (*r->p == '-' || *r->p == '+')) {
+		if (*r->p == '-')
+			sign = -1;
+		r->p++;
+	}
+	while (r->p < r->end && *r->p >= '0' && *r->p <= '9') {
+		if (v < 100000000) // saturate instead of overflowing, every bound check then rejects it
+			v = v*10 + (*r->p - '0');
+		r->p++;
+		digits++;
+	}
+	*value = sign*v;
+	return digits > 0;
+}
+
+static int read_cell (LevelReader* r, const Level* level, int* row, int* col)
+{
+	return read_int(r, row) && read_int(r, col)
+		&& *row >= 0 && *row < level->rows && *col >= 0 && *col < level->cols;
+}
+
+int parse_level (const char* text, int length, Level* level)
+{
+	LevelReader r = { text, text + length, 1 };
+	char word[16];
+
+	level->rows = level->cols = 0;
+	level->start_row = level->start_col = -1;
+	level->tiles.clear();
+	level->num_switches = 0;
+	level->num_teleports = 0;
+	level->merge[0] = level->merge[1] = level->merge[2] = level->merge[3] = -1;
+	level->handoff[0] = level->handoff[1] = -1;
+
+	for (; r.p < r.end; next_line(&r)) {
+		if (at_line_end(&r))
+			continue;
+		read_word(&r, word, sizeof(word));
+
+		if (!strcmp(word, "size")) {
+			// Only once, and before the grid, so the tiles always match rows*cols
+			if (level->rows > 0 || !level->tiles.empty())
+				goto error;
+			if (!read_int(&r, &level->rows) || !read_int(&r, &level->cols)
+				|| level->rows <= 0 || level->cols <= 0 || level->rows > LEVEL_MAX_SIZE || level->cols > LEVEL_MAX_SIZE)
+				goto error;
+		}
+		else if (!strcmp(word, "start")) {
+			if (!read_cell(&r, level, &level->start_row, &level->start_col))
+				goto error;
+		}
+		else if (!strcmp(word, "grid")) {
+			if (level->rows <= 0)
+				goto error;
+			level->tiles.resize(level->rows*level->cols);
+			for (int i=0; i<level->rows; i++) {
+				next_line(&r);
+				skip_blanks(&r);
+				if (r.end - r.p < level->cols)
+					goto error;
+				for (int j=0; j<level->cols; j++) {
+					char c = r.p[j];
+					if (c < '0' || c > '7')
+						goto error;
+					level->tiles[i*level->cols + j] = c - '0';
+				}
+				r.p += level->cols;
+			}
+		}
+		else if (!strcmp(word, "switch")) {
+			if (level->num_switches == LEVEL_MAX_SWITCHES)
+				goto error;
+			LevelSwitch* s = &level->switches[level->num_switches];
+			if (!read_cell(&r, level, &s->row, &s->col))
+				goto error;
+			read_word(&r, word, sizeof(word));
+			s->heavy = !strcmp(word, "heavy");
+			if (!s->heavy && strcmp(word, "soft"))
+				goto error;
+			read_word(&r, word, sizeof(word));
+			s->toggle = !strcmp(word, "toggle");
+			if (!s->toggle && strcmp(word, "once"))
+				goto error;
+			s->count = 0;
+			s->latched = 0;
+			while (!at_line_end(&r)) {
+				if (s->count == LEVEL_MAX_BRIDGE || !read_cell(&r, level, &s->cells[s->count][0], &s->cells[s->count][1]))
+					goto error;
+				s->count++;
+			}
+			level->num_switches++;
+		}
+		else if (!strcmp(word, "teleport")) {
+			if (level->num_teleports == LEVEL_MAX_TELEPORTS)
+				goto error;
+			LevelTeleport* t = &level->teleports[level->num_teleports];
+			if (!read_cell(&r, level, &t->row, &t->col))
+				goto error;
+			for (int k=0; k<6; k++)
+				if (!read_int(&r, &t->delta[k/3][k%3]))
+					goto error;
+			level->num_teleports++;
+		}
+		else if (!strcmp(word, "merge")) {
+			if (!read_cell(&r, level, &level->merge[0], &level->merge[1]) || !read_cell(&r, level, &level->merge[2], &level->merge[3]))
+				goto error;
+		}
+		else if (!strcmp(word, "handoff")) {
+			if (!read_cell(&r, level, &level->handoff[0], &level->handoff[1]))
+				goto error;
+		}
+		else
+			goto error;
+
+		if (!at_line_end(&r))
+			goto error;
+	}
+
+	if (level->tiles.empty() || level->start_row < 0) {
+		fprintf(stderr, "Error: level has no grid or start position\n");
+		return -1;
+	}
+	return 0;
+
+error:
+	fprintf(stderr, "Error: malformed level at line %d\n", r.line);
+	return -1;
+}
+
+int load_level (const char* path, Level* level)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "Error: Could not open level `%s'\n", path);
+		return -1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	std::vector<char> text(length > 0 ? length : 1);
+	length = fread(&text[0], 1, length, f);
+	fclose(f);
+
+	if (parse_level(&text[0], length, level) < 0) {
+		fprintf(stderr, "Error: Could not load level `%s'\n", path);
+		return -1;
+	}
+	return 0;
+}
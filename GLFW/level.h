@@ -0,0 +1,60 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <vector>
+
+/*
+ * Level file format - one directive per line, '#' starts a comment.
+ *
+ *   size <rows> <cols>                 once, before the grid, at most LEVEL_MAX_SIZE each
+ *   start <row> <col>                  cell the standing block starts on
+ *   grid                               followed by <rows> lines of <cols> digits:
+ *                                        0 empty, 1 normal, 2 switch, 3 heavy switch,
+ *                                        4 goal, 5 marker, 6 fragile, 7 teleport
+ *   switch <row> <col> soft|heavy toggle|once <row> <col> ...
+ *                                      soft: one cube on the switch presses it, heavy: both
+ *                                      toggle: every press flips the bridge cells, once: lays them
+ *   teleport <row> <col> <dx1> <dy1> <dz1> <dx2> <dy2> <dz2>
+ *                                      splits the block, moving each cube by (col, height, row) cells
+ *   merge <row1> <col1> <row2> <col2>  split cubes on these cells are joined again
+ *   handoff <row> <col>                cube 2 on this cell gives control to cube 1
+ *
+ * The file is read with a single read and parsed in one pass.
+ */
+
+#define LEVEL_MAX_SWITCHES 8
+#define LEVEL_MAX_BRIDGE 8
+#define LEVEL_MAX_TELEPORTS 4
+#define LEVEL_MAX_SIZE 1024 // per side, keeps rows*cols well inside an int
+
+struct LevelSwitch {
+	int row, col;
+	int heavy;
+	int toggle;
+	int count;
+	int cells[LEVEL_MAX_BRIDGE][2];
+	int latched; // switch was pressed on the previous check
+};
+
+struct LevelTeleport {
+	int row, col;
+	int delta[2][3]; // per cube: x (col), y (height), z (row) in cells
+};
+
+struct Level {
+	int rows, cols;
+	int start_row, start_col;
+	std::vector<int> tiles; // rows*cols, row major
+
+	int num_switches;
+	LevelSwitch switches[LEVEL_MAX_SWITCHES];
+	int num_teleports;
+	LevelTeleport teleports[LEVEL_MAX_TELEPORTS];
+	int merge[4];   // row1 col1 row2 col2, -1 if unused
+	int handoff[2]; // row col, -1 if unused
+};
+
+int parse_level (const char* text, int length, Level* level);
+int load_level (const char* path, Level* level);
+
+#endif
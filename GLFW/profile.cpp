@@ -0,0 +1,214 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <glad/glad.h>
+#include "profile.h"
+
+#define PROFILE_LATENCY 4  // frames a GPU timing has to come back before it is dropped
+#define PROFILE_QUERIES 64 // GPU timings per frame, phase entries past that go untimed
+#define PROFILE_DEPTH 8
+
+typedef std::chrono::steady_clock Clock;
+
+const char* profile_names[PROF_PHASES] = { "input", "sim", "tiles", "block", "submit", "text", "swap", "frame" };
+static const int phase_draws[PROF_PHASES] = { 0, 0, 1, 1, 1, 1, 0, 0 };
+
+struct ProfileFrame {
+	float cpu[PROF_PHASES]; // ms
+	float gpu[PROF_PHASES]; // ms, -1 if not timed
+};
+
+/* The GPU queries of one frame */
+struct QuerySet {
+	GLuint ids[PROFILE_QUERIES];
+	int phase[PROFILE_QUERIES];
+	int used;
+	long frame;
+};
+
+struct Profiler {
+	int gpu; // timer queries work
+	const char* csv_path;
+	std::vector<ProfileFrame> all; // every frame, kept only for the CSV
+	ProfileFrame window[PROFILE_WINDOW];
+	long frames;
+
+	ProfileFrame current;
+	Clock::time_point frame_start;
+	int stack[PROFILE_DEPTH];
+	int depth;
+	Clock::time_point resumed; // when the phase on top of the stack last started running
+	int query_open;
+
+	QuerySet sets[PROFILE_LATENCY];
+} Prof;
+
+static double ms_since (Clock::time_point t)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+}
+
+static void write_csv ()
+{
+	FILE* f = fopen(Prof.csv_path, "w");
+	if (!f) {
+		fprintf(stderr, "Error: Could not write profile `%s'\n", Prof.csv_path);
+		return;
+	}
+	fprintf(f, "frame");
+	for (int g=0; g<2; g++)
+		for (int p=0; p<PROF_PHASES; p++)
+			fprintf(f, ",%s_%s", profile_names[p], g ? "gpu" : "cpu");
+	fprintf(f, "\n");
+
+	for (size_t i=0; i<Prof.all.size(); i++) {
+		fprintf(f, "%ld", (long)i);
+		for (int p=0; p<PROF_PHASES; p++)
+			fprintf(f, ",%.4f", Prof.all[i].cpu[p]);
+		for (int p=0; p<PROF_PHASES; p++) {
+			if (Prof.all[i].gpu[p] < 0)
+				fprintf(f, ",");
+			else
+				fprintf(f, ",%.4f", Prof.all[i].gpu[p]);
+		}
+		fprintf(f, "\n");
+	}
+	fclose(f);
+}
+
+/* Needs the GL context. With a csv_path every frame is written there at exit. */
+void profile_init (const char* csv_path)
+{
+	Prof.gpu = GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+	for (int s=0; s<PROFILE_LATENCY; s++) {
+		if (Prof.gpu)
+			glGenQueries(PROFILE_QUERIES, Prof.sets[s].ids);
+		Prof.sets[s].used = 0;
+		Prof.sets[s].frame = -1;
+	}
+	memset(&Prof.current, 0, sizeof(Prof.current));
+	Prof.frame_start = Clock::now();
+	Prof.frames = 0;
+	Prof.depth = 0;
+	Prof.query_open = 0;
+
+	Prof.csv_path = csv_path;
+	if (csv_path)
+		atexit(write_csv);
+}
+
+static void pause_top ()
+{
+	Prof.current.cpu[Prof.stack[Prof.depth-1]] += ms_since(Prof.resumed);
+	if (Prof.query_open) {
+		glEndQuery(GL_TIME_ELAPSED);
+		Prof.query_open = 0;
+	}
+}
+
+static void resume_top ()
+{
+	int phase = Prof.stack[Prof.depth-1];
+	QuerySet* set = &Prof.sets[Prof.frames % PROFILE_LATENCY];
+	if (Prof.gpu && phase_draws[phase] && set->used < PROFILE_QUERIES) {
+		set->phase[set->used] = phase;
+		glBeginQuery(GL_TIME_ELAPSED, set->ids[set->used++]);
+		Prof.query_open = 1;
+	}
+	Prof.resumed = Clock::now();
+}
+
+void profile_begin (int phase)
+{
+	if (Prof.depth == PROFILE_DEPTH)
+		return;
+	if (Prof.depth > 0)
+		pause_top();
+	Prof.stack[Prof.depth++] = phase;
+	resume_top();
+}
+
+void profile_end (int phase)
+{
+	if (Prof.depth == 0 || Prof.stack[Prof.depth-1] != phase)
+		return;
+	pause_top();
+	Prof.depth--;
+	if (Prof.depth > 0)
+		resume_top();
+}
+
+/* Read back a finished frame's queries into its history entry */
+static void resolve (QuerySet* set)
+{
+	if (set->frame < 0)
+		return;
+	float gpu[PROF_PHASES];
+	for (int p=0; p<PROF_PHASES; p++)
+		gpu[p] = (Prof.gpu && phase_draws[p]) ? 0 : -1;
+
+	for (int q=0; q<set->used; q++) {
+		GLint available = 0;
+		glGetQueryObjectiv(set->ids[q], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return; // still in flight after PROFILE_LATENCY frames, leave the frame untimed
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(set->ids[q], GL_QUERY_RESULT, &ns);
+		gpu[set->phase[q]] += ns/1e6;
+	}
+
+	if (Prof.frames - set->frame <= PROFILE_WINDOW)
+		memcpy(Prof.window[set->frame % PROFILE_WINDOW].gpu, gpu, sizeof(gpu));
+	if (Prof.csv_path)
+		memcpy(Prof.all[set->frame].gpu, gpu, sizeof(gpu));
+}
+
+/* Close the frame, call once per main loop pass with no phase open */
+void profile_frame ()
+{
+	Prof.current.cpu[PROF_FRAME] = ms_since(Prof.frame_start);
+	Prof.frame_start = Clock::now();
+	for (int p=0; p<PROF_PHASES; p++)
+		Prof.current.gpu[p] = -1;
+
+	Prof.window[Prof.frames % PROFILE_WINDOW] = Prof.current;
+	if (Prof.csv_path)
+		Prof.all.push_back(Prof.current);
+	Prof.sets[Prof.frames % PROFILE_LATENCY].frame = Prof.frames;
+	Prof.frames++;
+	memset(&Prof.current, 0, sizeof(Prof.current));
+
+	// The set the next frame reuses holds the oldest queries
+	QuerySet* set = &Prof.sets[Prof.frames % PROFILE_LATENCY];
+	resolve(set);
+	set->used = 0;
+	set->frame = -1;
+}
+
+void profile_stats (int phase, int gpu, ProfileStats* stats)
+{
+	static float values[PROFILE_WINDOW];
+	int n = 0;
+	int frames = Prof.frames < PROFILE_WINDOW ? Prof.frames : PROFILE_WINDOW;
+	for (int i=0; i<frames; i++) {
+		float v = gpu ? Prof.window[i].gpu[phase] : Prof.window[i].cpu[phase];
+		if (v >= 0)
+			values[n++] = v;
+	}
+
+	stats->samples = n;
+	stats->min = stats->avg = stats->p99 = 0;
+	if (n == 0)
+		return;
+	float sum = 0;
+	for (int i=0; i<n; i++)
+		sum += values[i];
+	int k = (int)(0.99f*(n-1));
+	std::nth_element(values, values + k, values + n);
+	stats->p99 = values[k];
+	stats->min = *std::min_element(values, values + n);
+	stats->avg = sum/n;
+}
@@ -0,0 +1,44 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+ * Frame profiler. The frame is split into phases, each timed on the CPU
+ * and, for the phases that draw, on the GPU with GL_TIME_ELAPSED queries
+ * (read back a few frames later so the CPU never waits for them).
+ *
+ * Phases may nest: while an inner phase runs the outer one is paused, so
+ * every phase gets only its own time (a move made from a key callback is
+ * "sim", not "input"). A phase can be entered several times per frame.
+ *
+ * The last PROFILE_WINDOW frames give the min/avg/p99 shown on the HUD;
+ * with a CSV path every frame is also kept and written out at exit.
+ */
+
+#define PROFILE_WINDOW 300
+
+enum ProfilePhase {
+	PROF_INPUT,
+	PROF_SIM,
+	PROF_TILES,
+	PROF_BLOCK,
+	PROF_SUBMIT, // the render queue's sorted draws
+	PROF_TEXT,
+	PROF_SWAP,
+	PROF_FRAME, // the whole frame, timed by profile_frame()
+	PROF_PHASES
+};
+
+struct ProfileStats {
+	float min, avg, p99; // ms
+	int samples;         // 0 if the phase has no such timings (GPU of input, no timer queries)
+};
+
+extern const char* profile_names[PROF_PHASES];
+
+void profile_init (const char* csv_path);
+void profile_begin (int phase);
+void profile_end (int phase);
+void profile_frame ();
+void profile_stats (int phase, int gpu, ProfileStats* stats);
+
+#endif
@@ -0,0 +1,64 @@
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "renderq.h"
+#include "glstate.h"
+
+RenderQueueStats renderq_last;
+
+static std::vector<RenderItem> queue; // kept across frames so it stops allocating
+static std::vector<RenderItem*> order;
+
+void renderq_add (int layer, GLuint program, GLint mvp_id, GLuint vao, GLenum primitive, int count, GLenum fill, const float* mvp)
+{
+	RenderItem r;
+	r.layer = layer;
+	r.program = program;
+	r.vao = vao;
+	r.fill = fill;
+	r.primitive = primitive;
+	r.count = count;
+	r.mvp_id = mvp_id;
+	memcpy(r.mvp, mvp, sizeof(r.mvp));
+	r.seq = queue.size();
+	queue.push_back(r);
+}
+
+static bool before (const RenderItem* a, const RenderItem* b)
+{
+	if (a->layer != b->layer)
+		return a->layer < b->layer;
+	if (a->program != b->program)
+		return a->program < b->program;
+	if (a->vao != b->vao)
+		return a->vao < b->vao;
+	if (a->fill != b->fill)
+		return a->fill < b->fill;
+	return a->seq < b->seq;
+}
+
+void renderq_flush ()
+{
+	// Sort pointers, an item is 100 bytes
+	order.resize(queue.size());
+	for (size_t i=0; i<queue.size(); i++)
+		order[i] = &queue[i];
+	std::sort(order.begin(), order.end(), before);
+
+	renderq_last.items = queue.size();
+	renderq_last.batches = 0;
+	const RenderItem* prev = NULL;
+	for (size_t i=0; i<order.size(); i++) {
+		const RenderItem* r = order[i];
+		if (!prev || r->program != prev->program || r->vao != prev->vao || r->fill != prev->fill) {
+			glstate_use_program(r->program);
+			glstate_bind_vertex_array(r->vao);
+			glstate_polygon_mode(r->fill);
+			renderq_last.batches++;
+		}
+		glUniformMatrix4fv(r->mvp_id, 1, GL_FALSE, r->mvp);
+		glDrawArrays(r->primitive, 0, r->count);
+		prev = r;
+	}
+	queue.clear();
+}
@@ -0,0 +1,41 @@
+#ifndef RENDERQ_H
+#define RENDERQ_H
+
+#include <glad/glad.h>
+
+/*
+ * Render queue. The drawing code of a frame only submits items;
+ * renderq_flush() sorts them by layer, program, mesh and fill mode and
+ * draws them. Program, VAO and fill mode are set once per batch of items
+ * that share them, and each item then costs its MVP upload and a draw call.
+ * Building the frame and handing it to GL are timed apart this way.
+ *
+ * Layers keep the painter's order where it matters. Depth testing is done
+ * with GL_LEQUAL, so of two coplanar items the later one wins: the 2D
+ * screens put a button on a higher layer than the panel under it. Items
+ * with the same layer, program, mesh and fill mode keep their submit order.
+ */
+
+struct RenderItem {
+	int layer;
+	GLuint program;
+	GLuint vao;
+	GLenum fill;
+	GLenum primitive;
+	int count;     // vertices
+	GLint mvp_id;  // location of the program's MVP uniform
+	float mvp[16]; // column major, as glm stores it
+	int seq;       // submit order
+};
+
+struct RenderQueueStats {
+	int items;
+	int batches;
+};
+
+extern RenderQueueStats renderq_last; // the last flush
+
+void renderq_add (int layer, GLuint program, GLint mvp_id, GLuint vao, GLenum primitive, int count, GLenum fill, const float* mvp);
+void renderq_flush ();
+
+#endif
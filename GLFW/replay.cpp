@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <cstring>
+#include "replay.h"
+
+bool replay_recording = false;
+static FILE* record_file;
+
+int replay_record_start (const char* path)
+{
+	record_file = fopen(path, "wb");
+	if (!record_file) {
+		fprintf(stderr, "Error: Could not open input log `%s'\n", path);
+		return -1;
+	}
+	uint32_t version = REPLAY_VERSION;
+	fwrite("BLXINPUT", 1, 8, record_file);
+	fwrite(&version, sizeof(version), 1, record_file);
+	replay_recording = true;
+	return 0;
+}
+
+void replay_record (uint32_t tick, int type, int code, int action, double x, double y)
+{
+	if (!replay_recording)
+		return;
+	InputEvent e;
+	e.tick = tick;
+	e.type = type;
+	e.action = action;
+	e.code = code;
+	e.x = x;
+	e.y = y;
+	fwrite(&e, sizeof(e), 1, record_file);
+}
+
+void replay_record_stop (uint32_t tick)
+{
+	if (!replay_recording)
+		return;
+	replay_record(tick, INPUT_END, 0, 0, 0, 0);
+	fclose(record_file);
+	replay_recording = false;
+}
+
+int replay_load (const char* path, std::vector<InputEvent>* events)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "Error: Could not open input log `%s'\n", path);
+		return -1;
+	}
+	char magic[8];
+	uint32_t version;
+	if (fread(magic, 1, 8, f) != 8 || memcmp(magic, "BLXINPUT", 8) || fread(&version, sizeof(version), 1, f) != 1 || version != REPLAY_VERSION) {
+		fprintf(stderr, "Error: `%s' is not an input log\n", path);
+		fclose(f);
+		return -1;
+	}
+	InputEvent e;
+	while (fread(&e, sizeof(e), 1, f) == 1)
+		events->push_back(e);
+	fclose(f);
+	// A log cut short (the game crashed) still plays up to its last event
+	if (events->empty() || events->back().type != INPUT_END) {
+		e.tick = events->empty() ? 0 : events->back().tick;
+		e.type = INPUT_END;
+		e.action = e.code = 0;
+		e.x = e.y = 0;
+		events->push_back(e);
+	}
+	return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ * Input log for reproducible runs (--record <file>, --replay <file>).
+ *
+ * Every input callback the game gets is stored with the number of game
+ * steps played when it arrived. The game only changes in update() and in
+ * the callbacks - draw() only reads it - so feeding the events back before the same step, one step
+ * per frame, plays the recorded session again exactly. The cursor is
+ * recorded whenever the game reads it, not as it moves, and with every
+ * button event.
+ *
+ * File: "BLXINPUT", uint32 version, then InputEvent records; the last one
+ * is INPUT_END with the step the recording stopped at.
+ */
+
+#define REPLAY_VERSION 2
+
+enum InputType {
+	INPUT_KEY,    // code: GLFW key, action
+	INPUT_BUTTON, // code: GLFW mouse button, action, x, y: cursor position
+	INPUT_SCROLL, // x, y: scroll offsets
+	INPUT_CURSOR, // x, y: cursor position the game read
+	INPUT_DRAG,   // the main loop rotated the camera with the mouse
+	INPUT_END
+};
+
+struct InputEvent {
+	uint32_t tick;
+	uint8_t type;
+	uint8_t action;
+	uint16_t code;
+	float x, y;
+};
+
+extern bool replay_recording;
+
+int replay_record_start (const char* path);
+void replay_record (uint32_t tick, int type, int code, int action, double x, double y);
+void replay_record_stop (uint32_t tick);
+
+/* Returns -1 if the file is missing or not an input log */
+int replay_load (const char* path, std::vector<InputEvent>* events);
+
+#endif
@@ -0,0 +1,141 @@
+#include "sim.h"
+
+/* Standing block on the level's start cell, cube 2 on top */
+void sim_start (const Level* level, SimState* s)
+{
+	s->col[0] = s->col[1] = level->start_col;
+	s->row[0] = s->row[1] = level->start_row;
+	s->height[0] = 0;
+	s->height[1] = 1;
+	s->split = 0;
+	s->flipped = 0;
+	s->latched = 0;
+	s->status = SIM_PLAYING;
+	s->events = 0;
+	s->moves = 0;
+}
+
+/* Tile type of a cell with the switches applied, cells off the board are empty */
+int sim_tile (const Level* level, const SimState* s, int row, int col)
+{
+	if (row < 0 || col < 0 || row >= level->rows || col >= level->cols)
+		return 0;
+	int type = level->tiles[row*level->cols + col];
+
+	for (int k=0; k<level->num_switches; k++) {
+		if (!(s->flipped & (1u << k)))
+			continue;
+		const LevelSwitch* sw = &level->switches[k];
+		for (int c=0; c<sw->count; c++)
+			if (sw->cells[c][0] == row && sw->cells[c][1] == col)
+				type = (type == 0);
+	}
+	return type;
+}
+
+/* Roll a joined block along one axis: pos[] is each cube's coordinate on that axis, dir is +1 or -1 */
+static void roll (int* pos, int* height, int dir)
+{
+	if (pos[0] == pos[1] && height[1] > height[0]) { // standing, tips over
+		pos[0] += dir;
+		pos[1] += 2*dir;
+		height[1]--;
+	}
+	else if (pos[0] == pos[1] && height[0] > height[1]) {
+		pos[0] += 2*dir;
+		pos[1] += dir;
+		height[0]--;
+	}
+	else if (height[0] == height[1] && pos[0] != pos[1]) { // lying along the axis, stands up
+		int back = (pos[0] - pos[1])*dir > 0; // the cube behind goes over the top
+		pos[back] += 2*dir;
+		pos[1-back] += dir;
+		height[back]++;
+	}
+	else if (height[0] == height[1]) { // lying across the axis, rolls sideways
+		pos[0] += dir;
+		pos[1] += dir;
+	}
+}
+
+static int on_cell (const SimState* s, int cube, int row, int col)
+{
+	return s->row[cube] == row && s->col[cube] == col;
+}
+
+/* Switches, fragile tiles, teleports and merging for the block's new position */
+static int apply_tiles (const Level* level, SimState* s)
+{
+	int teleported = 0;
+
+	// Soft switches are pressed by either cube, heavy ones need both
+	for (int k=0; k<level->num_switches; k++) {
+		const LevelSwitch* sw = &level->switches[k];
+		unsigned bit = 1u << k;
+		int on1 = on_cell(s, 0, sw->row, sw->col);
+		int on2 = on_cell(s, 1, sw->row, sw->col);
+		int pressed = sw->heavy ? (on1 && on2) : (on1 || on2);
+		if (pressed && !(s->latched & bit)
+			&& (sw->toggle || sim_tile(level, s, sw->cells[0][0], sw->cells[0][1]) == 0)) {
+			s->flipped ^= bit;
+			s->events |= SIM_EV_SWITCH;
+		}
+		if (pressed)
+			s->latched |= bit;
+		else
+			s->latched &= ~bit;
+	}
+
+	// Standing upright on a fragile tile breaks it
+	if (sim_tile(level, s, s->row[0], s->col[0]) == 6 && sim_tile(level, s, s->row[1], s->col[1]) == 6
+		&& s->height[0] != s->height[1])
+		s->events |= SIM_EV_BREAK;
+
+	// Teleports split the block, the cubes are joined again on the merge cells
+	for (int k=0; k<level->num_teleports; k++) {
+		const LevelTeleport* t = &level->teleports[k];
+		if (on_cell(s, 0, t->row, t->col) && on_cell(s, 1, t->row, t->col)) {
+			for (int c=0; c<2; c++) {
+				s->col[c] += t->delta[c][0];
+				s->height[c] += t->delta[c][1];
+				s->row[c] += t->delta[c][2];
+			}
+			s->split = 1;
+			s->events |= SIM_EV_TELEPORT;
+			teleported = 1;
+		}
+	}
+	if (level->merge[0] >= 0 && on_cell(s, 0, level->merge[0], level->merge[1]) && on_cell(s, 1, level->merge[2], level->merge[3]))
+		s->split = 0;
+	else if (level->handoff[0] >= 0 && on_cell(s, 1, level->handoff[0], level->handoff[1]))
+		s->split = 2;
+
+	return teleported;
+}
+
+/* Roll the block once. Returns the new status, steps after the block fell or won do nothing. */
+int sim_step (const Level* level, SimState* s, int move)
+{
+	s->events = 0;
+	if (s->status != SIM_PLAYING)
+		return s->status;
+
+	int* axis = (move == SIM_RIGHT || move == SIM_LEFT) ? s->col : s->row;
+	int dir = (move == SIM_RIGHT || move == SIM_DOWN) ? 1 : -1;
+	if (s->split == 0)
+		roll(axis, s->height, dir);
+	else
+		axis[s->split == 1 ? 1 : 0] += dir;
+	s->moves++;
+
+	// A teleport lands the cubes on new cells, whose tiles apply in turn
+	for (int pass=0; pass<=LEVEL_MAX_TELEPORTS && apply_tiles(level, s); pass++)
+		;
+
+	if ((s->events & SIM_EV_BREAK)
+		|| sim_tile(level, s, s->row[0], s->col[0]) == 0 || sim_tile(level, s, s->row[1], s->col[1]) == 0)
+		s->status = SIM_FELL;
+	else if (sim_tile(level, s, s->row[0], s->col[0]) == 4 && sim_tile(level, s, s->row[1], s->col[1]) == 4)
+		s->status = SIM_WON;
+	return s->status;
+}
@@ -0,0 +1,39 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include "level.h"
+
+/*
+ * Rolling block simulation, no GL or GLFW in here.
+ *
+ * A SimState is a plain value: it holds the two cubes, the split state
+ * and the switches, so the level's tiles stay untouched and a state can
+ * be copied, compared or thrown away freely. sim_step() rolls the block
+ * once and applies the tile rules (switches, fragile tiles, teleports,
+ * merging) the same way the game does, without allocating.
+ */
+
+enum SimMove { SIM_RIGHT, SIM_LEFT, SIM_UP, SIM_DOWN, SIM_MOVES };
+enum SimStatus { SIM_PLAYING, SIM_FELL, SIM_WON };
+
+/* What the last step set off, for sounds and the board display */
+#define SIM_EV_SWITCH   1 // a switch flipped its bridge
+#define SIM_EV_BREAK    2 // the block broke the fragile tile under it
+#define SIM_EV_TELEPORT 4
+
+struct SimState {
+	int col[2], row[2]; // board cell of each cube
+	int height[2];      // in cube sizes, 0 is resting on the board
+	int split;          // 0 joined, 1 only cube 2 moves, 2 only cube 1 moves
+	unsigned flipped;   // bit k: the bridge of switch k is flipped from the level
+	unsigned latched;   // bit k: switch k was already pressed before this step
+	int status;
+	int events;
+	int moves;          // steps taken since sim_start()
+};
+
+void sim_start (const Level* level, SimState* s);
+int sim_step (const Level* level, SimState* s, int move);
+int sim_tile (const Level* level, const SimState* s, int row, int col);
+
+#endif
@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <cstring>
+#include <sys/time.h>
+#include "sim.h"
+#include "solver.h"
+
+/*
+ * Level checker: ./solve [-astar] levels/level1.lvl levels/level2.lvl ...
+ * Prints the optimal move count and moves (R L U D) of every level,
+ * with the states the search went through.
+ */
+
+static double now_ms ()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec*1000.0 + tv.tv_usec/1000.0;
+}
+
+int main (int argc, char** argv)
+{
+	const char move_names[SIM_MOVES+1] = "RLUD";
+	int method = SOLVER_BFS;
+	int failed = 0;
+
+	for (int i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "-astar")) {
+			method = SOLVER_ASTAR;
+			continue;
+		}
+
+		Level level;
+		SolverResult result;
+		if (load_level(argv[i], &level) < 0) {
+			failed = 1;
+			continue;
+		}
+		double start = now_ms();
+		if (solve_level(&level, method, &result) < 0) {
+			failed = 1;
+			continue;
+		}
+		double time = now_ms() - start;
+
+		if (!result.solved) {
+			printf("%s: unsolvable, %ld states explored, %.2f ms\n", argv[i], result.explored, time);
+			failed = 1;
+			continue;
+		}
+		printf("%s: %d moves, %ld states explored, %ld stored, %.2f ms\n  ",
+			argv[i], (int)result.path.size(), result.explored, result.stored, time);
+		for (int m=0; m<(int)result.path.size(); m++)
+			putchar(move_names[result.path[m]]);
+		putchar('\n');
+	}
+	return failed;
+}
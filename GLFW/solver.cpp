@@ -0,0 +1,275 @@
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include "sim.h"
+#include "solver.h"
+
+/*
+ * State key, low bit first:
+ *   10 col of cube 1, 10 row of cube 1, 10 col of cube 2, 10 row of cube 2,
+ *   3+3 heights (+4), 2 split, 8 flipped switches, 8 latched switches
+ */
+#define KEY_CELL_BITS 10
+#define KEY_MAX_CELLS (1 << KEY_CELL_BITS)
+#define KEY_HEIGHT_BIAS 4
+
+static int encode_state (const SimState* s, uint64_t* key)
+{
+	uint64_t k = 0;
+	int shift = 0;
+	for (int c=0; c<2; c++) {
+		k |= (uint64_t)s->col[c] << shift;
+		k |= (uint64_t)s->row[c] << (shift + KEY_CELL_BITS);
+		shift += 2*KEY_CELL_BITS;
+	}
+	for (int c=0; c<2; c++) {
+		int h = s->height[c] + KEY_HEIGHT_BIAS;
+		if (h < 0 || h > 7)
+			return 0;
+		k |= (uint64_t)h << (40 + 3*c);
+	}
+	k |= (uint64_t)s->split << 46;
+	k |= (uint64_t)(s->flipped & 0xff) << 48;
+	k |= (uint64_t)(s->latched & 0xff) << 56;
+	*key = k;
+	return 1;
+}
+
+static void decode_state (uint64_t k, SimState* s)
+{
+	int shift = 0;
+	for (int c=0; c<2; c++) {
+		s->col[c] = (k >> shift) & (KEY_MAX_CELLS-1);
+		s->row[c] = (k >> (shift + KEY_CELL_BITS)) & (KEY_MAX_CELLS-1);
+		shift += 2*KEY_CELL_BITS;
+		s->height[c] = (int)((k >> (40 + 3*c)) & 7) - KEY_HEIGHT_BIAS;
+	}
+	s->split = (k >> 46) & 3;
+	s->flipped = (k >> 48) & 0xff;
+	s->latched = (k >> 56) & 0xff;
+	s->status = SIM_PLAYING;
+	s->events = 0;
+	s->moves = 0;
+}
+
+/* One visited state: how it was reached and in how many moves */
+struct SolverNode {
+	uint64_t key;
+	int parent;
+	int depth;
+	int move;
+};
+
+/* Open addressing, linear probing, kept under half full */
+struct StateTable {
+	std::vector<uint64_t> keys;
+	std::vector<int> nodes; // index into the node list, -1 for a free slot
+	int mask;
+	int used;
+};
+
+static void table_init (StateTable* t, int capacity)
+{
+	int size = 1024;
+	while (size < 2*capacity)
+		size *= 2;
+	t->keys.assign(size, 0);
+	t->nodes.assign(size, -1);
+	t->mask = size - 1;
+	t->used = 0;
+}
+
+static uint32_t hash_key (uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	return (uint32_t)k;
+}
+
+/* Slot holding the key, or the free slot where it belongs */
+static int table_slot (const StateTable* t, uint64_t key)
+{
+	int i = hash_key(key) & t->mask;
+	while (t->nodes[i] >= 0 && t->keys[i] != key)
+		i = (i + 1) & t->mask;
+	return i;
+}
+
+static void table_grow (StateTable* t)
+{
+	StateTable bigger;
+	table_init(&bigger, t->keys.size());
+	for (int i=0; i<(int)t->keys.size(); i++)
+		if (t->nodes[i] >= 0) {
+			int j = table_slot(&bigger, t->keys[i]);
+			bigger.keys[j] = t->keys[i];
+			bigger.nodes[j] = t->nodes[i];
+		}
+	bigger.used = t->used;
+	t->keys.swap(bigger.keys);
+	t->nodes.swap(bigger.nodes);
+	t->mask = bigger.mask;
+}
+
+/* Goal cells and the lower bound on the moves left used by A* */
+struct Goals {
+	std::vector<int> cells; // row, col pairs
+};
+
+static int moves_left (const Goals* goals, const SimState* s)
+{
+	// A move shifts each cube by at most two cells
+	int worst = 0;
+	for (int c=0; c<2; c++) {
+		int best = -1;
+		for (int g=0; g<(int)goals->cells.size(); g+=2) {
+			int d = abs(s->row[c] - goals->cells[g]) + abs(s->col[c] - goals->cells[g+1]);
+			if (best < 0 || d < best)
+				best = d;
+		}
+		if (best > worst)
+			worst = best;
+	}
+	return (worst + 1)/2;
+}
+
+int solve_level (const Level* level, int method, SolverResult* result)
+{
+	result->solved = 0;
+	result->path.clear();
+	result->explored = 0;
+	result->stored = 0;
+
+	if (level->rows > KEY_MAX_CELLS || level->cols > KEY_MAX_CELLS || level->num_switches > 8) {
+		fprintf(stderr, "Error: level is too big for the solver (%dx%d, %d switches)\n",
+			level->rows, level->cols, level->num_switches);
+		return -1;
+	}
+
+	Goals goals;
+	for (int i=0; i<level->rows; i++)
+		for (int j=0; j<level->cols; j++)
+			if (level->tiles[i*level->cols + j] == 4) {
+				goals.cells.push_back(i);
+				goals.cells.push_back(j);
+			}
+	if (goals.cells.empty())
+		return 0;
+	if (level->num_teleports > 0)
+		method = SOLVER_BFS;
+
+	// Reserve for every cell in every orientation up front, the table only grows past that
+	int estimate = level->rows*level->cols*3;
+	std::vector<SolverNode> nodes;
+	nodes.reserve(estimate);
+	StateTable table;
+	table_init(&table, estimate);
+
+	SimState start;
+	sim_start(level, &start);
+	SolverNode root;
+	encode_state(&start, &root.key);
+	root.parent = -1;
+	root.depth = 0;
+	root.move = -1;
+	nodes.push_back(root);
+	int slot = table_slot(&table, root.key);
+	table.keys[slot] = root.key;
+	table.nodes[slot] = 0;
+	table.used = 1;
+
+	// BFS reads the node list in order. A* keeps a bucket per f = depth + bound,
+	// a node whose depth improves is queued again and the stale entry skipped.
+	std::vector< std::vector<int> > buckets;
+	int bucket = 0;
+	size_t next = 0;
+	if (method == SOLVER_ASTAR) {
+		buckets.resize(moves_left(&goals, &start) + 1);
+		buckets.back().push_back(0);
+		bucket = buckets.size() - 1;
+	}
+
+	int found = -1;
+	while (found < 0) {
+		int n;
+		if (method == SOLVER_ASTAR) {
+			while (bucket < (int)buckets.size() && buckets[bucket].empty())
+				bucket++;
+			if (bucket == (int)buckets.size())
+				break;
+			n = buckets[bucket].back();
+			buckets[bucket].pop_back();
+			SimState s;
+			decode_state(nodes[n].key, &s);
+			if (nodes[n].depth + moves_left(&goals, &s) != bucket)
+				continue;
+			// Only a goal taken off the queue is known to be the closest one
+			if (sim_tile(level, &s, s.row[0], s.col[0]) == 4 && sim_tile(level, &s, s.row[1], s.col[1]) == 4) {
+				found = n;
+				break;
+			}
+		}
+		else {
+			if (next == nodes.size())
+				break;
+			n = next++;
+		}
+		result->explored++;
+
+		SimState from;
+		decode_state(nodes[n].key, &from);
+		for (int m=0; m<SIM_MOVES; m++) {
+			SimState to = from;
+			int status = sim_step(level, &to, m);
+			if (status == SIM_FELL)
+				continue;
+
+			uint64_t key;
+			if (!encode_state(&to, &key))
+				continue;
+			int depth = nodes[n].depth + 1;
+			int i = table_slot(&table, key);
+			int child = table.nodes[i];
+			if (child >= 0) {
+				if (method == SOLVER_BFS || nodes[child].depth <= depth)
+					continue;
+			}
+			else {
+				child = nodes.size();
+				SolverNode node;
+				node.key = key;
+				nodes.push_back(node);
+				table.keys[i] = key;
+				table.nodes[i] = child;
+				if (++table.used*2 > (int)table.keys.size())
+					table_grow(&table);
+			}
+			nodes[child].parent = n;
+			nodes[child].depth = depth;
+			nodes[child].move = m;
+
+			if (status == SIM_WON && method == SOLVER_BFS) {
+				found = child;
+				break;
+			}
+			if (method == SOLVER_ASTAR) {
+				int f = depth + moves_left(&goals, &to);
+				if (f >= (int)buckets.size())
+					buckets.resize(f + 1);
+				buckets[f].push_back(child);
+				if (f < bucket)
+					bucket = f;
+			}
+		}
+	}
+
+	result->stored = nodes.size();
+	if (found < 0)
+		return 0;
+	result->solved = 1;
+	result->path.resize(nodes[found].depth);
+	for (int n=found; nodes[n].parent >= 0; n=nodes[n].parent)
+		result->path[nodes[n].depth - 1] = nodes[n].move;
+	return 0;
+}
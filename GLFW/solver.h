@@ -0,0 +1,31 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <vector>
+#include "level.h"
+
+/*
+ * Shortest solution of a level, searched over simulation states.
+ *
+ * Every state the block can be in while still on the board is packed
+ * into a 64-bit key (see solver.cpp) and kept in an open addressing hash
+ * table, so boards up to 1024x1024 cells with up to 8 switches fit.
+ * Breadth first search is used by default. A* with a distance-to-goal
+ * bound visits fewer states on big open boards, for levels without
+ * teleports (a teleport can jump the block past any bound).
+ */
+
+#define SOLVER_BFS   0
+#define SOLVER_ASTAR 1
+
+struct SolverResult {
+	int solved;            // 1 if the goal can be reached
+	std::vector<int> path; // SimMove per step, path.size() is the optimal move count
+	long explored;         // states taken off the queue
+	long stored;           // distinct states seen
+};
+
+/* Returns 0 when the search ran (solved or not), -1 if the level is too big to encode */
+int solve_level (const Level* level, int method, SolverResult* result);
+
+#endif
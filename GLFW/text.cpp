@@ -0,0 +1,240 @@
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "text.h"
+#include "glstate.h"
+#include "engine.h"
+
+#define TEXT_FIRST 32 // printable ASCII, anything else draws as '?'
+#define TEXT_LAST 126
+#define TEXT_ATLAS_WIDTH 1024
+
+struct Glyph {
+	float u0, v0, u1, v1; // atlas rectangle
+	float x0, y0, x1, y1; // quad around the pen, in em units
+	float advance;
+};
+
+struct TextVertex {
+	float pos[4]; // clip space
+	float uv[2];
+	float color[3];
+};
+
+struct TextString {
+	std::string str;
+	float mvp[16];
+	float color[3];
+	std::vector<TextVertex> verts;
+};
+
+struct TextBatch {
+	Glyph glyphs[TEXT_LAST-TEXT_FIRST+1];
+	GLuint program, texture, vao, vbo;
+	std::vector<TextString> strings; // in text_add() order, reused across frames
+	int count;                       // strings queued this frame
+	int dirty;                       // the VBO no longer matches strings[0..count)
+	int uploaded;                    // vertices in the VBO
+	size_t capacity;                 // VBO size in vertices
+	std::vector<TextVertex> upload;
+} Text;
+
+int text_init (const char* fontfile, int pixels, unsigned program)
+{
+	FT_Library library;
+	FT_Face face;
+	if (FT_Init_FreeType(&library))
+		return -1;
+	if (FT_New_Face(library, fontfile, 0, &face)) {
+		FT_Done_FreeType(library);
+		return -1;
+	}
+	FT_Set_Pixel_Sizes(face, 0, pixels);
+
+	// Shelf packing, the atlas grows downwards a row of glyphs at a time
+	std::vector<unsigned char> atlas;
+	int x = 1, y = 1, row_height = 0, height = 0;
+	int rects[TEXT_LAST-TEXT_FIRST+1][4] = {{0}};
+	for (int c=TEXT_FIRST; c<=TEXT_LAST; c++) {
+		Glyph* g = &Text.glyphs[c-TEXT_FIRST];
+		memset(g, 0, sizeof(Glyph));
+		if (FT_Load_Char(face, c, FT_LOAD_RENDER))
+			continue;
+		FT_GlyphSlot slot = face->glyph;
+		int w = slot->bitmap.width, h = slot->bitmap.rows;
+		if (x + w + 1 > TEXT_ATLAS_WIDTH) {
+			x = 1;
+			y += row_height + 1;
+			row_height = 0;
+		}
+		if (y + h + 1 > height) {
+			height = y + h + 1;
+			atlas.resize(TEXT_ATLAS_WIDTH*height);
+		}
+		for (int r=0; r<h; r++)
+			memcpy(&atlas[(y+r)*TEXT_ATLAS_WIDTH + x], slot->bitmap.buffer + r*slot->bitmap.pitch, w);
+
+		rects[c-TEXT_FIRST][0] = x;
+		rects[c-TEXT_FIRST][1] = y;
+		rects[c-TEXT_FIRST][2] = w;
+		rects[c-TEXT_FIRST][3] = h;
+		g->x0 = slot->bitmap_left/(float)pixels;
+		g->x1 = (slot->bitmap_left + w)/(float)pixels;
+		g->y0 = (slot->bitmap_top - h)/(float)pixels;
+		g->y1 = slot->bitmap_top/(float)pixels;
+		g->advance = (slot->advance.x/64.0f)/pixels;
+		x += w + 1;
+		if (h > row_height)
+			row_height = h;
+	}
+	FT_Done_Face(face);
+	FT_Done_FreeType(library);
+	if (atlas.empty()) // no glyph could be rasterized
+		return -1;
+
+	for (int c=TEXT_FIRST; c<=TEXT_LAST; c++) {
+		Glyph* g = &Text.glyphs[c-TEXT_FIRST];
+		int* r = rects[c-TEXT_FIRST];
+		if (g->advance == 0 && g->x1 == 0)
+			continue;
+		g->u0 = r[0]/(float)TEXT_ATLAS_WIDTH;
+		g->u1 = (r[0] + r[2])/(float)TEXT_ATLAS_WIDTH;
+		// Bitmap rows run top down, the atlas is uploaded with row 0 at v=0
+		g->v0 = (r[1] + r[3])/(float)height;
+		g->v1 = r[1]/(float)height;
+	}
+
+	glGenTextures(1, &Text.texture);
+	glstate_bind_texture(Text.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, TEXT_ATLAS_WIDTH, height, 0, GL_RED, GL_UNSIGNED_BYTE, &atlas[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	Text.program = program;
+	glstate_use_program(program);
+	glUniform1i(glGetUniformLocation(program, "atlas"), 0); // the atlas is on texture unit 0
+
+	Text.vao = genVertexArray();
+	glstate_bind_vertex_array(Text.vao);
+	Text.vbo = genBuffer();
+	glstate_bind_array_buffer(Text.vbo);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, pos));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, uv));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, color));
+	glEnableVertexAttribArray(2);
+	glstate_bind_vertex_array(0);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // only the text blends
+
+	Text.count = 0;
+	Text.dirty = 0;
+	Text.uploaded = 0;
+	Text.capacity = 0;
+	return 0;
+}
+
+static const Glyph* glyph (char c)
+{
+	if (c < TEXT_FIRST || c > TEXT_LAST)
+		c = '?';
+	return &Text.glyphs[c-TEXT_FIRST];
+}
+
+float text_width (const char* str)
+{
+	float w = 0;
+	for (; *str; str++)
+		w += glyph(*str)->advance;
+	return w;
+}
+
+static void vertex (TextString* s, float x, float y, float u, float v)
+{
+	const float* m = s->mvp;
+	TextVertex t;
+	for (int i=0; i<4; i++)
+		t.pos[i] = m[i]*x + m[4+i]*y + m[12+i];
+	t.uv[0] = u;
+	t.uv[1] = v;
+	memcpy(t.color, s->color, sizeof(t.color));
+	s->verts.push_back(t);
+}
+
+/* Lay the string out again, only called when it changed */
+static void build (TextString* s)
+{
+	s->verts.clear();
+	float pen = 0;
+	for (size_t i=0; i<s->str.size(); i++) {
+		const Glyph* g = glyph(s->str[i]);
+		if (g->x1 > g->x0) {
+			float x0 = pen + g->x0, x1 = pen + g->x1;
+			vertex(s, x0, g->y0, g->u0, g->v0);
+			vertex(s, x1, g->y0, g->u1, g->v0);
+			vertex(s, x1, g->y1, g->u1, g->v1);
+			vertex(s, x0, g->y0, g->u0, g->v0);
+			vertex(s, x1, g->y1, g->u1, g->v1);
+			vertex(s, x0, g->y1, g->u0, g->v1);
+		}
+		pen += g->advance;
+	}
+}
+
+void text_add (const char* str, const float* mvp, const float* color)
+{
+	if (Text.count == (int)Text.strings.size())
+		Text.strings.push_back(TextString());
+	TextString* s = &Text.strings[Text.count++];
+	if (s->str == str && !memcmp(s->mvp, mvp, sizeof(s->mvp)) && !memcmp(s->color, color, sizeof(s->color)))
+		return;
+	s->str = str;
+	memcpy(s->mvp, mvp, sizeof(s->mvp));
+	memcpy(s->color, color, sizeof(s->color));
+	build(s);
+	Text.dirty = 1;
+}
+
+void text_flush ()
+{
+	// A frame with fewer strings than the last one also needs a new upload
+	if (Text.count < (int)Text.strings.size()) {
+		Text.strings.resize(Text.count);
+		Text.dirty = 1;
+	}
+	Text.count = 0;
+
+	if (Text.dirty) {
+		Text.upload.clear();
+		for (size_t i=0; i<Text.strings.size(); i++)
+			Text.upload.insert(Text.upload.end(), Text.strings[i].verts.begin(), Text.strings[i].verts.end());
+		Text.uploaded = Text.upload.size();
+		glstate_bind_array_buffer(Text.vbo);
+		if (Text.upload.size() > Text.capacity) {
+			Text.capacity = Text.upload.size()*2;
+			glBufferData(GL_ARRAY_BUFFER, Text.capacity*sizeof(TextVertex), NULL, GL_DYNAMIC_DRAW);
+		}
+		if (Text.uploaded)
+			glBufferSubData(GL_ARRAY_BUFFER, 0, Text.uploaded*sizeof(TextVertex), &Text.upload[0]);
+		Text.dirty = 0;
+	}
+	if (Text.uploaded == 0)
+		return;
+
+	glstate_use_program(Text.program);
+	glstate_bind_texture(Text.texture);
+	glstate_blend(1);
+	glstate_polygon_mode(GL_FILL);
+	glstate_bind_vertex_array(Text.vao);
+	glDrawArrays(GL_TRIANGLES, 0, Text.uploaded);
+	glstate_blend(0);
+}
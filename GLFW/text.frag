@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 fragUV;
+in vec3 fragColor;
+
+// glyph coverage in the red channel
+uniform sampler2D atlas;
+
+out vec4 color;
+
+void main()
+{
+    float coverage = texture(atlas, fragUV).r;
+    if (coverage == 0.0)
+        discard;
+    color = vec4(fragColor, coverage);
+}
@@ -0,0 +1,29 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+/*
+ * HUD text from a glyph atlas. The font's printable ASCII glyphs are
+ * rasterized once into a texture; every string queued during a frame is
+ * turned into textured quads and the whole frame's text is drawn with a
+ * single draw call from one dynamic VBO.
+ *
+ * Strings are matched to the previous frame by their order of text_add()
+ * calls. A string whose text, transform and colour are unchanged keeps its
+ * quads, and the VBO is only re-uploaded when something changed.
+ */
+
+/* Needs the GL context and the program built from text.vert/text.frag.
+   pixels is the rasterization size of one em, returns -1 if the font can't be loaded. */
+int text_init (const char* fontfile, int pixels, unsigned program);
+
+/* mvp (column major, as glm stores it) maps the string's em units to clip space,
+   the baseline starts at the origin like FTGL's Render() */
+void text_add (const char* str, const float* mvp, const float* color);
+
+/* Draw the frame's strings and start the next frame */
+void text_flush ();
+
+/* Width of str in em units */
+float text_width (const char* str);
+
+#endif
@@ -0,0 +1,16 @@
+#version 330 core
+
+// Glyph quads of the whole frame's text, already transformed on the CPU
+layout (location = 0) in vec4 vertexPosition; // clip space
+layout (location = 1) in vec2 vertexUV;
+layout (location = 2) in vec3 vertexColor;
+
+out vec2 fragUV;
+out vec3 fragColor;
+
+void main ()
+{
+    gl_Position = vertexPosition;
+    fragUV = vertexUV;
+    fragColor = vertexColor;
+}
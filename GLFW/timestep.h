@@ -0,0 +1,49 @@
+#ifndef TIMESTEP_H
+#define TIMESTEP_H
+
+/*
+ * Fixed timestep for the game loops. Real time is collected in an
+ * accumulator and spent in steps of exactly 1/TICK_HZ s, so the game
+ * advances the same at any frame rate; what is left over is the fraction
+ * of a step the frame is drawn at, to interpolate between the last two
+ * steps.
+ *
+ *   int n = timestep_advance(&step, glfwGetTime());
+ *   while (n--) update();
+ *   draw(timestep_alpha(&step));
+ */
+
+#define TICK_HZ 60
+#define TICK (1.0/TICK_HZ)
+#define TICK_MAX_STEPS 8 // per frame, after a long stall the game slows down instead of catching up
+
+struct Timestep {
+	double last;
+	double accumulator;
+};
+
+inline void timestep_start (Timestep* t, double now)
+{
+	t->last = now;
+	t->accumulator = 0;
+}
+
+/* Steps to run for the time since the last call */
+inline int timestep_advance (Timestep* t, double now)
+{
+	t->accumulator += now - t->last;
+	t->last = now;
+	int steps = (int)(t->accumulator/TICK);
+	t->accumulator -= steps*TICK;
+	if (steps > TICK_MAX_STEPS)
+		steps = TICK_MAX_STEPS;
+	return steps;
+}
+
+/* How far the frame is past the last step, 0..1 */
+inline float timestep_alpha (const Timestep* t)
+{
+	return (float)(t->accumulator/TICK);
+}
+
+#endif
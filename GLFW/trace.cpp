@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "trace.h"
+
+#define TRACE_RING (1 << 16) // events, a power of two
+#define TRACE_FLUSH_MS 50
+
+const char* trace_names[TRACE_NAMES] = {
+	"frame", "draw", "swap", "events", "key", "mouse", "move",
+	"level", "fall", "win", "camera", "tiles", "gl objects", "dropped"
+};
+
+bool trace_on = false;
+
+struct TraceRing {
+	TraceEvent events[TRACE_RING];
+	std::atomic<unsigned> head; // next event the main thread writes
+	std::atomic<unsigned> tail; // next event the flush thread writes out
+	unsigned dropped;           // main thread only
+	std::chrono::steady_clock::time_point start;
+	FILE* file;
+	std::thread thread;
+	std::atomic<bool> running;
+} Trace;
+
+/* Write out everything the main thread has finished, returns the events written */
+static unsigned flush_events ()
+{
+	unsigned tail = Trace.tail.load(std::memory_order_relaxed);
+	unsigned head = Trace.head.load(std::memory_order_acquire);
+	unsigned count = head - tail;
+	while (tail != head) {
+		// Up to the end of the ring in one write, the rest on the next pass
+		unsigned first = tail & (TRACE_RING-1);
+		unsigned n = head - tail;
+		if (n > TRACE_RING - first)
+			n = TRACE_RING - first;
+		fwrite(&Trace.events[first], sizeof(TraceEvent), n, Trace.file);
+		tail += n;
+	}
+	Trace.tail.store(tail, std::memory_order_release);
+	return count;
+}
+
+static void flush_loop ()
+{
+	while (Trace.running.load(std::memory_order_acquire)) {
+		if (flush_events() == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_FLUSH_MS));
+	}
+	flush_events();
+	fflush(Trace.file);
+}
+
+int trace_start (const char* path)
+{
+	if (trace_on)
+		return 0;
+	Trace.file = fopen(path, "wb");
+	if (!Trace.file) {
+		fprintf(stderr, "Error: Could not open trace `%s'\n", path);
+		return -1;
+	}
+
+	uint32_t header[2] = { TRACE_VERSION, TRACE_NAMES };
+	fwrite("BLXTRACE", 1, 8, Trace.file);
+	fwrite(header, sizeof(header), 1, Trace.file);
+	for (int i=0; i<TRACE_NAMES; i++)
+		fwrite(trace_names[i], 1, strlen(trace_names[i]) + 1, Trace.file);
+
+	Trace.head.store(0);
+	Trace.tail.store(0);
+	Trace.dropped = 0;
+	Trace.start = std::chrono::steady_clock::now();
+	Trace.running.store(true);
+	Trace.thread = std::thread(flush_loop);
+	trace_on = true;
+	atexit(trace_stop);
+	return 0;
+}
+
+/* Put the pending drop count at head, the caller makes room and publishes it */
+static unsigned write_dropped (unsigned head, uint64_t now)
+{
+	TraceEvent* d = &Trace.events[head & (TRACE_RING-1)];
+	d->time = now;
+	d->type = TRACE_INSTANT;
+	d->name = TRACE_DROPPED;
+	d->arg[0] = Trace.dropped;
+	d->arg[1] = 0;
+	d->pad = 0;
+	Trace.dropped = 0;
+	return head + 1;
+}
+
+void trace_stop ()
+{
+	if (!trace_on)
+		return;
+	trace_on = false;
+
+	// Events dropped since the last one that fit are only reported by the next
+	// event, so wait for the flush thread to make room and write the count now
+	if (Trace.dropped) {
+		unsigned head = Trace.head.load(std::memory_order_relaxed);
+		while (head - Trace.tail.load(std::memory_order_acquire) == TRACE_RING)
+			std::this_thread::yield();
+		uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Trace.start).count();
+		Trace.head.store(write_dropped(head, now), std::memory_order_release);
+	}
+
+	Trace.running.store(false, std::memory_order_release);
+	Trace.thread.join();
+	fclose(Trace.file);
+	Trace.file = NULL;
+}
+
+void trace_record (int type, int name, int arg0, int arg1)
+{
+	unsigned head = Trace.head.load(std::memory_order_relaxed);
+	unsigned free = TRACE_RING - (head - Trace.tail.load(std::memory_order_acquire));
+	if (free < 2) { // room for this event and a TRACE_DROPPED ahead of it
+		Trace.dropped++;
+		return;
+	}
+	uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Trace.start).count();
+
+	if (Trace.dropped)
+		head = write_dropped(head, now);
+
+	TraceEvent* e = &Trace.events[head & (TRACE_RING-1)];
+	e->time = now;
+	e->type = type;
+	e->name = name;
+	e->arg[0] = arg0;
+	e->arg[1] = arg1;
+	e->pad = 0;
+	Trace.head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,81 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Event trace, off unless trace_start() is called (--trace <file>).
+ *
+ * Events are 24 byte binary records put on a ring buffer by the main
+ * thread; a background thread writes them to the file, so recording an
+ * event is a few stores and never waits on I/O. When the ring is full
+ * events are dropped and a TRACE_DROPPED event says how many.
+ * trace2json turns a trace file into Chrome's trace event JSON
+ * (chrome://tracing or https://ui.perfetto.dev).
+ *
+ * File: "BLXTRACE", uint32 version, uint32 name count, the names as
+ * NUL terminated strings, then TraceEvent records up to the end.
+ */
+
+#define TRACE_VERSION 1
+
+enum TraceType { TRACE_BEGIN, TRACE_END, TRACE_INSTANT, TRACE_COUNTER };
+
+enum TraceName {
+	TRACE_FRAME,   // one pass of the main loop
+	TRACE_DRAW,
+	TRACE_SWAP,
+	TRACE_EVENTS,  // glfwPollEvents and the callbacks it runs
+	TRACE_KEY,     // key, action
+	TRACE_MOUSE,   // cursor x, y in whole pixels on a button press
+	TRACE_MOVE,    // SimMove, moves so far
+	TRACE_LEVEL,   // level started, attempt
+	TRACE_FALL,
+	TRACE_WIN,
+	TRACE_CAMERA,  // view, rotation angle in whole degrees
+	TRACE_TILES,   // tiles drawn, tiles culled
+	TRACE_GL_OBJECTS, // buffers, vertex arrays alive at the end of a frame
+	TRACE_DROPPED, // events lost because the ring was full
+	TRACE_NAMES
+};
+
+struct TraceEvent {
+	uint64_t time; // ns since trace_start()
+	uint16_t type;
+	uint16_t name;
+	int32_t arg[2];
+	uint32_t pad;
+};
+
+extern const char* trace_names[TRACE_NAMES];
+extern bool trace_on;
+
+int trace_start (const char* path);
+void trace_stop ();
+void trace_record (int type, int name, int arg0, int arg1);
+
+inline void trace_begin (int name)
+{
+	if (trace_on)
+		trace_record(TRACE_BEGIN, name, 0, 0);
+}
+
+inline void trace_end (int name)
+{
+	if (trace_on)
+		trace_record(TRACE_END, name, 0, 0);
+}
+
+inline void trace_instant (int name, int arg0, int arg1)
+{
+	if (trace_on)
+		trace_record(TRACE_INSTANT, name, arg0, arg1);
+}
+
+inline void trace_counter (int name, int arg0, int arg1)
+{
+	if (trace_on)
+		trace_record(TRACE_COUNTER, name, arg0, arg1);
+}
+
+#endif
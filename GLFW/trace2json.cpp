@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+/*
+ * Converts a trace written with --trace into Chrome trace event JSON:
+ *   ./trace2json game.trace > game.json
+ * Begin/end pairs become slices, instants and counters keep their two
+ * arguments as "a" and "b".
+ */
+
+static int read_name (FILE* f, std::string* name)
+{
+	int c;
+	name->clear();
+	while ((c = fgetc(f)) > 0)
+		*name += (char)c;
+	return c == 0;
+}
+
+int main (int argc, char** argv)
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+		return 1;
+	}
+	FILE* f = fopen(argv[1], "rb");
+	if (!f) {
+		fprintf(stderr, "Error: Could not open trace `%s'\n", argv[1]);
+		return 1;
+	}
+
+	char magic[8];
+	uint32_t header[2];
+	if (fread(magic, 1, 8, f) != 8 || memcmp(magic, "BLXTRACE", 8) || fread(header, sizeof(header), 1, f) != 1
+		|| header[0] != TRACE_VERSION) {
+		fprintf(stderr, "Error: `%s' is not a version %d trace\n", argv[1], TRACE_VERSION);
+		return 1;
+	}
+	std::vector<std::string> names(header[1]);
+	for (uint32_t i=0; i<header[1]; i++)
+		if (!read_name(f, &names[i])) {
+			fprintf(stderr, "Error: `%s' is truncated\n", argv[1]);
+			return 1;
+		}
+
+	static const char* phases[] = { "B", "E", "i", "C" };
+	TraceEvent events[1024];
+	size_t n;
+	int first = 1;
+	printf("{\"traceEvents\":[\n");
+	while ((n = fread(events, sizeof(TraceEvent), 1024, f)) > 0) {
+		for (size_t i=0; i<n; i++) {
+			const TraceEvent* e = &events[i];
+			if (e->type > TRACE_COUNTER || e->name >= names.size())
+				continue;
+			printf("%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":1",
+				first ? "" : ",\n", names[e->name].c_str(), phases[e->type], e->time/1000.0);
+			if (e->type == TRACE_INSTANT)
+				printf(",\"s\":\"t\"");
+			if (e->type == TRACE_INSTANT || e->type == TRACE_COUNTER)
+				printf(",\"args\":{\"a\":%d,\"b\":%d}", e->arg[0], e->arg[1]);
+			printf("}");
+			first = 0;
+		}
+	}
+	printf("\n]}\n");
+	fclose(f);
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include <cstddef>
+#include <vector>
+#include "ui.h"
+
+struct Widget {
+	int id;
+	unsigned screens;
+	float x0, y0, x1, y1;     // normalized
+	double px0, py0, px1, py1; // pixels, from the last layout
+};
+
+static struct {
+	std::vector<Widget> widgets;
+	std::vector<int> cells[UI_GRID*UI_GRID]; // indices of the widgets touching each cell, in the order they were added
+	int width, height;
+	int dirty; // widgets were added since the last layout
+} UI;
+
+void ui_add (int id, unsigned screens, float x0, float y0, float x1, float y1)
+{
+	Widget w = { id, screens, x0, y0, x1, y1, 0, 0, 0, 0 };
+	UI.widgets.push_back(w);
+	UI.dirty = 1;
+}
+
+static int cellOf (double p, int size)
+{
+	int c = (int)(p*UI_GRID/size);
+	return c < 0 ? 0 : c >= UI_GRID ? UI_GRID-1 : c;
+}
+
+static void layout ()
+{
+	for (int c=0; c<UI_GRID*UI_GRID; c++)
+		UI.cells[c].clear();
+	for (size_t i=0; i<UI.widgets.size(); i++) {
+		Widget* w = &UI.widgets[i];
+		w->px0 = w->x0*UI.width;
+		w->py0 = w->y0*UI.height;
+		w->px1 = w->x1*UI.width;
+		w->py1 = w->y1*UI.height;
+		for (int r=cellOf(w->py0, UI.height); r<=cellOf(w->py1, UI.height); r++)
+			for (int c=cellOf(w->px0, UI.width); c<=cellOf(w->px1, UI.width); c++)
+				UI.cells[r*UI_GRID + c].push_back(i);
+	}
+	UI.dirty = 0;
+}
+
+void ui_layout (int width, int height)
+{
+	if (width == UI.width && height == UI.height && !UI.dirty)
+		return;
+	UI.width = width;
+	UI.height = height;
+	layout();
+}
+
+int ui_hit (unsigned screens, double x, double y)
+{
+	if (UI.width <= 0 || UI.height <= 0)
+		return -1;
+	if (UI.dirty)
+		layout();
+	if (x < 0 || y < 0 || x >= UI.width || y >= UI.height)
+		return -1;
+	const std::vector<int>& cell = UI.cells[cellOf(y, UI.height)*UI_GRID + cellOf(x, UI.width)];
+	for (size_t k=0; k<cell.size(); k++) {
+		const Widget* w = &UI.widgets[cell[k]];
+		if ((w->screens & screens) && x > w->px0 && x < w->px1 && y > w->py0 && y < w->py1)
+			return w->id;
+	}
+	return -1;
+}
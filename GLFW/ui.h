@@ -0,0 +1,29 @@
+#ifndef UI_H
+#define UI_H
+
+/*
+ * Hit-testing of the on-screen buttons. A widget is a rectangle in
+ * normalized window coordinates (0,0 the top left corner, 1,1 the bottom
+ * right, the same way up as the cursor), so it stays on its button at any
+ * window size. ui_layout() turns them into pixels when the window size
+ * changes, and files each into the cells of a UI_GRID x UI_GRID grid over
+ * the window that it covers. ui_hit() only tests the widgets of the one
+ * cell under the cursor, so a click costs the same however many widgets
+ * the screens have.
+ *
+ * Each widget belongs to one or more screens (a bit mask chosen by the
+ * caller) and is only hit while one of them is shown.
+ */
+
+#define UI_GRID 16
+
+/* id is returned by ui_hit(), x0 < x1 and y0 < y1 */
+void ui_add (int id, unsigned screens, float x0, float y0, float x1, float y1);
+
+/* The window's size in screen coordinates (the cursor's, not the framebuffer's) */
+void ui_layout (int width, int height);
+
+/* The widget of one of the shown screens under the cursor at (x,y), -1 if none */
+int ui_hit (unsigned screens, double x, double y);
+
+#endif
@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "watch.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+struct WatchedFile {
+	std::string dir;
+	std::string name;
+	int wd; // inotify watch of dir
+};
+
+static struct {
+	std::vector<WatchedFile> files;
+	void (*changed) (int id);
+	int fd;
+	std::thread thread;
+	std::atomic<bool> running;
+} Watch;
+
+int watch_add (const char* path)
+{
+	if (Watch.files.size() == WATCH_MAX)
+		return -1;
+	WatchedFile f;
+	const char* slash = strrchr(path, '/');
+	f.dir = slash ? std::string(path, slash - path) : ".";
+	f.name = slash ? slash + 1 : path;
+	f.wd = -1;
+	Watch.files.push_back(f);
+	return Watch.files.size() - 1;
+}
+
+#ifdef __linux__
+
+static void watch_loop ()
+{
+	// Room for a few events with names, an inotify read returns whole events
+	char buf[16*(sizeof(inotify_event) + 256)] __attribute__((aligned(__alignof__(inotify_event))));
+	struct pollfd p = { Watch.fd, POLLIN, 0 };
+	while (Watch.running.load(std::memory_order_acquire)) {
+		// Wake up now and then to see if the game is quitting
+		if (poll(&p, 1, 100) <= 0)
+			continue;
+		ssize_t n = read(Watch.fd, buf, sizeof(buf));
+		if (n <= 0)
+			continue;
+
+		bool hit[WATCH_MAX] = { false };
+		for (char* e = buf; e < buf + n; e += sizeof(inotify_event) + ((inotify_event*)e)->len) {
+			const inotify_event* ev = (const inotify_event*)e;
+			if (!ev->len)
+				continue;
+			for (size_t i=0; i<Watch.files.size(); i++)
+				if (Watch.files[i].wd == ev->wd && Watch.files[i].name == ev->name)
+					hit[i] = true;
+		}
+		for (size_t i=0; i<Watch.files.size(); i++)
+			if (hit[i])
+				Watch.changed(i);
+	}
+}
+
+int watch_start (void (*changed) (int id))
+{
+	Watch.fd = inotify_init1(IN_CLOEXEC);
+	if (Watch.fd < 0) {
+		perror("inotify_init1");
+		return -1;
+	}
+	for (size_t i=0; i<Watch.files.size(); i++) {
+		// Files in one directory share its watch, inotify hands back the same descriptor
+		Watch.files[i].wd = inotify_add_watch(Watch.fd, Watch.files[i].dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (Watch.files[i].wd < 0)
+			fprintf(stderr, "Error: Could not watch `%s'\n", Watch.files[i].dir.c_str());
+	}
+
+	Watch.changed = changed;
+	Watch.running.store(true);
+	Watch.thread = std::thread(watch_loop);
+	// The loop polls with a 100 ms timeout, so the join at exit waits that long at most
+	atexit(watch_stop);
+	return 0;
+}
+
+void watch_stop ()
+{
+	if (!Watch.running.load())
+		return;
+	Watch.running.store(false, std::memory_order_release);
+	Watch.thread.join();
+	close(Watch.fd);
+}
+
+#else
+
+int watch_start (void (*changed) (int id))
+{
+	fprintf(stderr, "File watching needs inotify, hot reload is off\n");
+	return -1;
+}
+
+void watch_stop ()
+{
+}
+
+#endif
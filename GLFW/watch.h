@@ -0,0 +1,22 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+/*
+ * File watching for hot reload. The files are added first, then
+ * watch_start() runs a thread that waits on inotify for their directories
+ * and calls changed(id) on that thread for every watched file that was
+ * written or moved into place (editors often save by renaming a new file
+ * over the old one). A batch of events names each file once.
+ *
+ * inotify is Linux only; elsewhere watch_start() returns -1 and nothing
+ * is watched.
+ */
+
+/* Returns the file's id, or -1 once WATCH_MAX files are watched */
+int watch_add (const char* path);
+int watch_start (void (*changed) (int id));
+void watch_stop ();
+
+#define WATCH_MAX 64
+
+#endif